@@ -0,0 +1,304 @@
+#ifndef POLLER_HPP
+#define POLLER_HPP
+
+// I/O readiness backends shared by the reactors: select, poll and epoll behind one
+// interface. The reactor keeps its handler table; the poller only knows which fds
+// to watch and reports the ready ones, so dispatch cost follows the backend
+// (O(watched) for select/poll, O(ready) for epoll).
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <vector>
+
+// Interest and readiness bits
+enum PollerEvents {
+    POLLER_READ = 1,
+    POLLER_WRITE = 2,
+    POLLER_ERROR = 4,  // error or hangup, always reported
+    POLLER_EDGE = 8,   // edge-triggered interest (epoll only, ignored elsewhere)
+};
+
+// I/O multiplexing mechanism behind a reactor
+enum ReactorBackend {
+    BACKEND_SELECT,
+    BACKEND_POLL,
+    BACKEND_EPOLL,
+};
+
+// One ready descriptor
+struct PollerEvent {
+    int fd;
+    int events;
+};
+
+class Poller {
+public:
+    virtual ~Poller() {}
+
+    // Starts watching fd for the given POLLER_* interest; -1 on failure
+    virtual int add(int fd, int events) = 0;
+
+    // Changes the interest of a watched fd
+    virtual int modify(int fd, int events) = 0;
+
+    // Stops watching fd
+    virtual int remove(int fd) = 0;
+
+    // Blocks up to timeoutMs (-1 forever) and appends ready fds to out.
+    // Returns the number of ready fds, 0 on timeout or EINTR, -1 on error.
+    virtual int wait(std::vector<PollerEvent>& out, int timeoutMs) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// select(): capped at FD_SETSIZE and O(max fd) per wait
+class SelectPoller : public Poller {
+public:
+    SelectPoller() : maxFd(-1) {
+        FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
+    }
+
+    int add(int fd, int events) override {
+        if (fd < 0 || fd >= FD_SETSIZE) {
+            errno = EINVAL;
+            return -1;
+        }
+        if ((size_t)fd >= interest.size()) interest.resize(fd + 1, 0);
+        if (fd > maxFd) maxFd = fd;
+        return modify(fd, events);
+    }
+
+    int modify(int fd, int events) override {
+        if (fd < 0 || fd > maxFd) return -1;
+        interest[fd] = events | POLLER_ERROR;
+        FD_CLR(fd, &readFds);
+        FD_CLR(fd, &writeFds);
+        if (events & POLLER_READ) FD_SET(fd, &readFds);
+        if (events & POLLER_WRITE) FD_SET(fd, &writeFds);
+        return 0;
+    }
+
+    int remove(int fd) override {
+        if (fd < 0 || fd > maxFd || !interest[fd]) return -1;
+        interest[fd] = 0;
+        FD_CLR(fd, &readFds);
+        FD_CLR(fd, &writeFds);
+        while (maxFd >= 0 && !interest[maxFd]) --maxFd;
+        return 0;
+    }
+
+    int wait(std::vector<PollerEvent>& out, int timeoutMs) override {
+        fd_set r = readFds, w = writeFds;
+        struct timeval tv, *tvp = nullptr;
+        if (timeoutMs >= 0) {
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            tvp = &tv;
+        }
+        int ret = select(maxFd + 1, &r, &w, nullptr, tvp);
+        if (ret <= 0) return (ret < 0 && errno != EINTR) ? -1 : 0;
+
+        int found = 0;
+        for (int fd = 0; fd <= maxFd && found < ret; ++fd) {
+            int ev = 0;
+            if (FD_ISSET(fd, &r)) ev |= POLLER_READ;
+            if (FD_ISSET(fd, &w)) ev |= POLLER_WRITE;
+            if (ev) {
+                out.push_back(PollerEvent{fd, ev});
+                ++found;
+            }
+        }
+        return found;
+    }
+
+    const char* name() const override { return "select"; }
+
+private:
+    fd_set readFds;
+    fd_set writeFds;
+    int maxFd;
+    std::vector<int> interest;
+};
+
+// poll(): no fd cap but still O(watched) per wait
+class PollPoller : public Poller {
+public:
+    int add(int fd, int events) override {
+        if (fd < 0) return -1;
+        if ((size_t)fd >= slot.size()) slot.resize(fd + 1, -1);
+        if (slot[fd] >= 0) return modify(fd, events);
+        slot[fd] = (int)pollfds.size();
+        pollfds.push_back(pollfd{fd, toPoll(events), 0});
+        return 0;
+    }
+
+    int modify(int fd, int events) override {
+        if (fd < 0 || (size_t)fd >= slot.size() || slot[fd] < 0) return -1;
+        pollfds[slot[fd]].events = toPoll(events);
+        return 0;
+    }
+
+    // Swaps the last entry into the hole, O(1)
+    int remove(int fd) override {
+        if (fd < 0 || (size_t)fd >= slot.size() || slot[fd] < 0) return -1;
+        int i = slot[fd];
+        pollfds[i] = pollfds.back();
+        slot[pollfds[i].fd] = i;
+        pollfds.pop_back();
+        slot[fd] = -1;
+        return 0;
+    }
+
+    int wait(std::vector<PollerEvent>& out, int timeoutMs) override {
+        int ret = poll(pollfds.data(), pollfds.size(), timeoutMs);
+        if (ret <= 0) return (ret < 0 && errno != EINTR) ? -1 : 0;
+
+        int found = 0;
+        for (size_t i = 0; i < pollfds.size() && found < ret; ++i) {
+            short re = pollfds[i].revents;
+            if (!re) continue;
+            int ev = 0;
+            if (re & POLLIN) ev |= POLLER_READ;
+            if (re & POLLOUT) ev |= POLLER_WRITE;
+            if (re & (POLLERR | POLLHUP | POLLNVAL)) ev |= POLLER_ERROR;
+            out.push_back(PollerEvent{pollfds[i].fd, ev});
+            ++found;
+        }
+        return found;
+    }
+
+    const char* name() const override { return "poll"; }
+
+private:
+    static short toPoll(int events) {
+        short ev = 0;
+        if (events & POLLER_READ) ev |= POLLIN;
+        if (events & POLLER_WRITE) ev |= POLLOUT;
+        return ev;
+    }
+
+    std::vector<struct pollfd> pollfds;
+    std::vector<int> slot;  // fd -> index in pollfds, -1 if not watched
+};
+
+// epoll: kernel-side interest list, O(ready) per wait
+class EpollPoller : public Poller {
+public:
+    EpollPoller() : epfd(epoll_create1(EPOLL_CLOEXEC)), events(64) {
+        if (epfd < 0) perror("epoll_create1");
+    }
+
+    ~EpollPoller() override {
+        if (epfd >= 0) close(epfd);
+    }
+
+    int add(int fd, int ev) override {
+        return control(EPOLL_CTL_ADD, fd, ev);
+    }
+
+    int modify(int fd, int ev) override {
+        return control(EPOLL_CTL_MOD, fd, ev);
+    }
+
+    int remove(int fd) override {
+        return epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    int wait(std::vector<PollerEvent>& out, int timeoutMs) override {
+        int ret = epoll_wait(epfd, events.data(), (int)events.size(), timeoutMs);
+        if (ret <= 0) return (ret < 0 && errno != EINTR) ? -1 : 0;
+
+        for (int i = 0; i < ret; ++i) {
+            uint32_t re = events[i].events;
+            int ev = 0;
+            if (re & (EPOLLIN | EPOLLRDHUP)) ev |= POLLER_READ;
+            if (re & EPOLLOUT) ev |= POLLER_WRITE;
+            if (re & (EPOLLERR | EPOLLHUP)) ev |= POLLER_ERROR;
+            out.push_back(PollerEvent{events[i].data.fd, ev});
+        }
+        // A full batch means more may be pending; take more next time
+        if ((size_t)ret == events.size() && events.size() < 4096) events.resize(events.size() * 2);
+        return ret;
+    }
+
+    const char* name() const override { return "epoll"; }
+
+private:
+    int control(int op, int fd, int ev) {
+        struct epoll_event e;
+        memset(&e, 0, sizeof(e));
+        if (ev & POLLER_READ) e.events |= EPOLLIN | EPOLLRDHUP;
+        if (ev & POLLER_WRITE) e.events |= EPOLLOUT;
+        if (ev & POLLER_EDGE) e.events |= EPOLLET;
+        e.data.fd = fd;
+        return epoll_ctl(epfd, op, fd, &e);
+    }
+
+    int epfd;
+    std::vector<struct epoll_event> events;
+};
+
+// eventfd that another thread signals to interrupt a wait(). The loop watches
+// fd() for POLLER_READ and drains it when it fires, so it can block with no
+// timeout and still see registration changes and stop requests at once.
+class Wakeup {
+public:
+    Wakeup() : efd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (efd < 0) perror("eventfd");
+    }
+
+    ~Wakeup() {
+        if (efd >= 0) close(efd);
+    }
+
+    int fd() const { return efd; }
+
+    void signal() {
+        uint64_t one = 1;
+        // Only fails, with EAGAIN, if the counter would overflow; a wakeup is
+        // pending then anyway
+        ssize_t ret = write(efd, &one, sizeof(one));
+        (void)ret;
+    }
+
+    // Resets the counter; one read takes all pending signals
+    void drain() {
+        uint64_t count;
+        ssize_t ret = read(efd, &count, sizeof(count));
+        (void)ret;
+    }
+
+private:
+    Wakeup(const Wakeup&);
+    Wakeup& operator=(const Wakeup&);
+
+    int efd;
+};
+
+// Creates the poller for a backend
+inline Poller* createPoller(ReactorBackend backend) {
+    switch (backend) {
+        case BACKEND_SELECT: return new SelectPoller();
+        case BACKEND_POLL: return new PollPoller();
+        default: return new EpollPoller();
+    }
+}
+
+// Parses "select", "poll" or "epoll"; returns false for anything else
+inline bool parseBackend(const char* name, ReactorBackend& backend) {
+    if (strcmp(name, "select") == 0) backend = BACKEND_SELECT;
+    else if (strcmp(name, "poll") == 0) backend = BACKEND_POLL;
+    else if (strcmp(name, "epoll") == 0) backend = BACKEND_EPOLL;
+    else return false;
+    return true;
+}
+
+#endif // POLLER_HPP
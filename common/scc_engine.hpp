@@ -0,0 +1,326 @@
+#ifndef SCC_ENGINE_HPP
+#define SCC_ENGINE_HPP
+
+// Header-only Kosaraju engine shared by the benchmarks and the servers.
+//
+// The traversal is written once and templated on an adjacency-storage policy.
+// A policy stores one direction of the graph and exposes:
+//
+//   void build(int n, const std::vector<std::pair<int, int>>& edges, bool reversed);
+//   Cursor open(int v) const;               // start iterating v's neighbors
+//   bool next(Cursor& c, int& u) const;     // next neighbor, false when exhausted
+//   size_t bytes() const;                   // approximate footprint
+//
+// Cursors are plain structs, so the neighbor loop is specialized and inlined per
+// backend. Adding a backend means adding a policy, not another copy of the DFS.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace scc {
+
+typedef std::vector<std::pair<int, int>> EdgeList;
+
+// Phases of one query, reported to the observer
+enum Phase {
+    PHASE_BUILD,  // building adj/revAdj
+    PHASE_DFS1,   // finishing order on the graph
+    PHASE_DFS2,   // components on the transposed graph
+};
+
+// Observer that ignores everything; the calls compile away
+struct NullObserver {
+    void phaseBegin(Phase) {}
+    void phaseEnd(Phase) {}
+    void vertex(Phase, size_t /*depth*/) {}
+    void edge(Phase) {}
+};
+
+inline bool inRange(int n, const std::pair<int, int>& e) {
+    return e.first >= 0 && e.first <= n && e.second >= 0 && e.second <= n;
+}
+
+// vector<Container<int>> adjacency: list, deque or vector rows
+template <template <class, class> class Container>
+class SequenceAdjacency {
+public:
+    typedef Container<int, std::allocator<int>> Row;
+
+    struct Cursor {
+        typename Row::const_iterator it, end;
+    };
+
+    void build(int n, const EdgeList& edges, bool reversed) {
+        rows.assign(n + 1, Row());
+        edgeCount = 0;
+        for (const auto& e : edges) {
+            if (!inRange(n, e)) continue;
+            if (reversed) rows[e.second].push_back(e.first);
+            else rows[e.first].push_back(e.second);
+            ++edgeCount;
+        }
+    }
+
+    Cursor open(int v) const {
+        return Cursor{rows[v].begin(), rows[v].end()};
+    }
+
+    bool next(Cursor& c, int& u) const {
+        if (c.it == c.end) return false;
+        u = *c.it++;
+        return true;
+    }
+
+    size_t bytes() const;
+
+private:
+    std::vector<Row> rows;
+    size_t edgeCount = 0;
+};
+
+typedef SequenceAdjacency<std::list> ListAdjacency;
+typedef SequenceAdjacency<std::deque> DequeAdjacency;
+typedef SequenceAdjacency<std::vector> VectorAdjacency;
+
+// A list node carries two links next to the value
+template <>
+inline size_t ListAdjacency::bytes() const {
+    return rows.capacity() * sizeof(Row) + edgeCount * (2 * sizeof(void*) + sizeof(int) + 4);
+}
+
+// A deque allocates a 512-byte block and a map for every non-empty row
+template <>
+inline size_t DequeAdjacency::bytes() const {
+    size_t total = rows.capacity() * sizeof(Row);
+    for (const Row& r : rows) {
+        total += 8 * sizeof(int*) + ((r.size() * sizeof(int)) / 512 + 1) * 512;
+    }
+    return total;
+}
+
+template <>
+inline size_t VectorAdjacency::bytes() const {
+    size_t total = rows.capacity() * sizeof(Row);
+    for (const Row& r : rows) total += r.capacity() * sizeof(int);
+    return total;
+}
+
+// Compressed sparse rows: one offsets array and one targets array.
+// Built with a stable counting sort so neighbors keep their insertion order.
+class CsrAdjacency {
+public:
+    struct Cursor {
+        const int* it;
+        const int* end;
+    };
+
+    void build(int n, const EdgeList& edges, bool reversed) {
+        offsets.assign(n + 2, 0);
+        for (const auto& e : edges) {
+            if (!inRange(n, e)) continue;
+            ++offsets[(reversed ? e.second : e.first) + 1];
+        }
+        for (int v = 0; v <= n; ++v) offsets[v + 1] += offsets[v];
+
+        targets.resize(offsets[n + 1]);
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (const auto& e : edges) {
+            if (!inRange(n, e)) continue;
+            if (reversed) targets[fill[e.second]++] = e.first;
+            else targets[fill[e.first]++] = e.second;
+        }
+    }
+
+    Cursor open(int v) const {
+        return Cursor{targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    bool next(Cursor& c, int& u) const {
+        if (c.it == c.end) return false;
+        u = *c.it++;
+        return true;
+    }
+
+    size_t bytes() const {
+        return offsets.capacity() * sizeof(int) + targets.capacity() * sizeof(int);
+    }
+
+private:
+    std::vector<int> offsets;
+    std::vector<int> targets;
+};
+
+// Dense adjacency matrix with one bit per (v, u); neighbors come out in increasing order.
+// O(n^2) bits, so only for small dense graphs.
+class BitMatrixAdjacency {
+public:
+    struct Cursor {
+        const uint64_t* row;
+        size_t word;
+        uint64_t bits;
+    };
+
+    void build(int n, const EdgeList& edges, bool reversed) {
+        words = ((size_t)n + 1 + 63) / 64;
+        matrix.assign(((size_t)n + 1) * words, 0);
+        for (const auto& e : edges) {
+            if (!inRange(n, e)) continue;
+            int from = reversed ? e.second : e.first;
+            int to = reversed ? e.first : e.second;
+            matrix[(size_t)from * words + to / 64] |= 1ull << (to % 64);
+        }
+    }
+
+    Cursor open(int v) const {
+        const uint64_t* row = matrix.data() + (size_t)v * words;
+        return Cursor{row, 0, words ? row[0] : 0};
+    }
+
+    bool next(Cursor& c, int& u) const {
+        while (c.bits == 0) {
+            if (++c.word >= words) return false;
+            c.bits = c.row[c.word];
+        }
+        u = (int)(c.word * 64 + __builtin_ctzll(c.bits));
+        c.bits &= c.bits - 1;
+        return true;
+    }
+
+    size_t bytes() const {
+        return matrix.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    size_t words = 0;
+    std::vector<uint64_t> matrix;
+};
+
+// Iterative DFS that visits vertices in the same order as the recursive version,
+// without the recursion limit on long paths.
+template <class Adjacency, class Observer>
+class Traversal {
+public:
+    Traversal(const Adjacency& adj, std::vector<bool>& visited, Observer& obs, Phase phase)
+        : adj(adj), visited(visited), obs(obs), phase(phase) {}
+
+    // Visits everything reachable from root; onEnter runs in preorder, onExit in postorder
+    template <class Enter, class Exit>
+    void run(int root, Enter onEnter, Exit onExit) {
+        enter(root, onEnter);
+        while (!stack.empty()) {
+            int u;
+            Frame& top = stack.back();
+            if (adj.next(top.cursor, u)) {
+                obs.edge(phase);
+                if (!visited[u]) enter(u, onEnter);
+            } else {
+                onExit(top.vertex);
+                stack.pop_back();
+            }
+        }
+    }
+
+private:
+    struct Frame {
+        int vertex;
+        typename Adjacency::Cursor cursor;
+    };
+
+    template <class Enter>
+    void enter(int v, Enter& onEnter) {
+        visited[v] = true;
+        stack.push_back(Frame{v, adj.open(v)});
+        obs.vertex(phase, stack.size());
+        onEnter(v);
+    }
+
+    const Adjacency& adj;
+    std::vector<bool>& visited;
+    Observer& obs;
+    Phase phase;
+    std::vector<Frame> stack;
+};
+
+// Builds the forward and transposed adjacency for vertices 0..n
+template <class Adjacency>
+struct Graph {
+    Adjacency adj;
+    Adjacency revAdj;
+
+    Graph(int n, const EdgeList& edges) {
+        adj.build(n, edges, false);
+        revAdj.build(n, edges, true);
+    }
+
+    size_t bytes() const {
+        return adj.bytes() + revAdj.bytes();
+    }
+};
+
+// Kosaraju's algorithm. onComponent(v) is called for each member of a component in
+// discovery order and onComponentEnd() after its last member, so callers decide
+// whether to materialize member lists. A negative n is an empty graph.
+template <class Adjacency, class Observer, class Member, class End>
+void kosarajuVisit(int n, const EdgeList& edges, Observer& obs, Member onComponent, End onComponentEnd) {
+    if (n < 0) n = 0;
+    obs.phaseBegin(PHASE_BUILD);
+    Graph<Adjacency> graph(n, edges);
+    obs.phaseEnd(PHASE_BUILD);
+
+    obs.phaseBegin(PHASE_DFS1);
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<bool> visited(n + 1, false);
+    {
+        Traversal<Adjacency, Observer> dfs(graph.adj, visited, obs, PHASE_DFS1);
+        for (int i = 1; i <= n; ++i) {
+            if (!visited[i]) {
+                dfs.run(i, [](int) {}, [&order](int v) { order.push_back(v); });
+            }
+        }
+    }
+    obs.phaseEnd(PHASE_DFS1);
+
+    obs.phaseBegin(PHASE_DFS2);
+    std::fill(visited.begin(), visited.end(), false);
+    {
+        Traversal<Adjacency, Observer> dfs(graph.revAdj, visited, obs, PHASE_DFS2);
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (!visited[*it]) {
+                dfs.run(*it, onComponent, [](int) {});
+                onComponentEnd();
+            }
+        }
+    }
+    obs.phaseEnd(PHASE_DFS2);
+}
+
+// Kosaraju's algorithm returning the members of every SCC
+template <class Adjacency, class Observer>
+std::vector<std::vector<int>> kosaraju(int n, const EdgeList& edges, Observer& obs) {
+    std::vector<std::vector<int>> sccs;
+    std::vector<int> component;
+    kosarajuVisit<Adjacency>(n, edges, obs,
+        [&component](int v) { component.push_back(v); },
+        [&sccs, &component]() {
+            sccs.push_back(component);
+            component.clear();
+        });
+    return sccs;
+}
+
+template <class Adjacency = CsrAdjacency>
+std::vector<std::vector<int>> kosaraju(int n, const EdgeList& edges) {
+    NullObserver obs;
+    return kosaraju<Adjacency>(n, edges, obs);
+}
+
+} // namespace scc
+
+#endif // SCC_ENGINE_HPP
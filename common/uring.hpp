@@ -0,0 +1,209 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+// Minimal io_uring ring on the raw syscalls (no liburing): submission and
+// completion queues mapped from the kernel, plus a pool of provided receive
+// buffers. Single-threaded: one thread fills SQEs and reaps CQEs.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class Uring {
+public:
+    explicit Uring(unsigned entries = 256) : ringFd(-1), sqRing(nullptr), cqRing(nullptr), sqes(nullptr),
+                                             sqRingSize(0), cqRingSize(0), sqesSize(0), sqLocalTail(0), sqSubmitted(0) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ringFd < 0 && errno == EINVAL) {
+            // Older kernel: retry without the hints
+            memset(&p, 0, sizeof(p));
+            ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        }
+        if (ringFd < 0) return;
+
+        sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single && cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            fail();
+            return;
+        }
+        if (single) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                fail();
+                return;
+            }
+        }
+        sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (struct io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          ringFd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            fail();
+            return;
+        }
+
+        char* sq = (char*)sqRing;
+        sqHead = (unsigned*)(sq + p.sq_off.head);
+        sqTail = (unsigned*)(sq + p.sq_off.tail);
+        sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+        sqEntries = p.sq_entries;
+        unsigned* array = (unsigned*)(sq + p.sq_off.array);
+        for (unsigned i = 0; i < sqEntries; ++i) array[i] = i;  // SQE slots map 1:1
+        sqLocalTail = sqSubmitted = *sqTail;
+
+        char* cq = (char*)cqRing;
+        cqHead = (unsigned*)(cq + p.cq_off.head);
+        cqTail = (unsigned*)(cq + p.cq_off.tail);
+        cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    }
+
+    ~Uring() {
+        fail();
+    }
+
+    bool ok() const { return ringFd >= 0; }
+
+    // Next free SQE, zeroed; submits pending SQEs first if the queue is full.
+    // Returns nullptr only if the kernel refuses to take any.
+    struct io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (sqLocalTail - head >= sqEntries) {
+            if (submit(0) < 0) return nullptr;
+            head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if (sqLocalTail - head >= sqEntries) return nullptr;
+        }
+        struct io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        ++sqLocalTail;
+        return sqe;
+    }
+
+    // Publishes queued SQEs and, with waitNr > 0, blocks until that many
+    // completions are available. One io_uring_enter for both.
+    int submit(unsigned waitNr) {
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+        unsigned toSubmit = sqLocalTail - sqSubmitted;
+        if (toSubmit == 0 && waitNr == 0) return 0;
+        if (waitNr > 0 && pendingCompletions() > 0) waitNr = 0;
+        unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int ret = (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, waitNr, flags, nullptr, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return 0;
+            return -1;
+        }
+        sqSubmitted += ret;
+        return ret;
+    }
+
+    // SQEs that can be filled before the queue is full
+    unsigned freeSqes() const {
+        return sqEntries - (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE));
+    }
+
+    // Completions ready to be reaped
+    unsigned pendingCompletions() const {
+        return __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) - *cqHead;
+    }
+
+    // Copies out the oldest completion and releases its slot; false if none
+    bool popCompletion(struct io_uring_cqe& out) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        out = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void fail() {
+        if (sqes && sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing && sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        sqes = nullptr;
+        sqRing = cqRing = nullptr;
+        if (ringFd >= 0) close(ringFd);
+        ringFd = -1;
+    }
+
+    int ringFd;
+    void* sqRing;
+    void* cqRing;
+    struct io_uring_sqe* sqes;
+    size_t sqRingSize, cqRingSize, sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqLocalTail;   // SQEs filled in
+    unsigned sqSubmitted;   // SQEs handed to the kernel
+
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+};
+
+// Fixed-size receive buffers the kernel picks from (IOSQE_BUFFER_SELECT), so a
+// multishot recv needs no buffer per connection. Buffers are handed over and
+// given back with IORING_OP_PROVIDE_BUFFERS, which rides along with the next
+// submission instead of costing a syscall of its own.
+class ProvidedBuffers {
+public:
+    ProvidedBuffers(Uring& ring, unsigned short group, unsigned count, unsigned size)
+        : group(group), count(count), size(size), ring(ring) {
+        void* m = mmap(nullptr, (size_t)count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        memory = m == MAP_FAILED ? nullptr : (char*)m;
+        if (memory && ring.ok()) provide(0, count);
+    }
+
+    ~ProvidedBuffers() {
+        if (memory) munmap(memory, (size_t)count * size);
+    }
+
+    bool ok() const { return memory != nullptr; }
+
+    char* buffer(unsigned id) { return memory + (size_t)id * size; }
+
+    // Hands a consumed buffer back to the kernel
+    void recycle(unsigned id) {
+        provide(id, 1);
+    }
+
+    const unsigned short group;
+    const unsigned count;
+    const unsigned size;
+
+private:
+    void provide(unsigned first, unsigned n) {
+        struct io_uring_sqe* sqe = ring.getSqe();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = (int)n;
+        sqe->addr = (uint64_t)(uintptr_t)buffer(first);
+        sqe->len = size;
+        sqe->off = first;  // id of the first buffer
+        sqe->buf_group = group;
+        sqe->user_data = 0;  // completes with user_data 0
+    }
+
+    Uring& ring;
+    char* memory;
+};
+
+#endif // URING_HPP
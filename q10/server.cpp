@@ -1,7 +1,5 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include <stack>
 #include <algorithm>
 #include <sstream>
 #include <cstring>
@@ -9,6 +7,7 @@
 #include <arpa/inet.h>
 #include <mutex>
 #include <pthread.h>
+#include "../common/scc_engine.hpp"
 
 
 using namespace std;
@@ -18,62 +17,9 @@ mutex graphMutex;               // Mutex for thread-safe access to graph data
 int n = 0, m = 0;               // Number of vertices and edges
 vector<pair<int, int>> edges;   // Vector to store graph edges
 
-// Depth-first search function to fill finishing order in finishStack
-void dfs1(int v, const vector<list<int>>& adj, vector<bool>& visited, stack<int>& finishStack) {
-    visited[v] = true;
-    for (int u : adj[v]) {
-        if (!visited[u]) {
-            dfs1(u, adj, visited, finishStack); // Recursive call for unvisited neighbors
-        }
-    }
-    finishStack.push(v); // Push vertex to stack after all neighbors are visited
-}
-
-// Depth-first search function to find strongly connected components (SCCs)
-void dfs2(int v, const vector<list<int>>& revAdj, vector<bool>& visited, vector<int>& component) {
-    visited[v] = true;
-    component.push_back(v); // Add vertex to current SCC
-    for (int u : revAdj[v]) {
-        if (!visited[u]) {
-            dfs2(u, revAdj, visited, component); // Recursive call for unvisited neighbors
-        }
-    }
-}
-
 // Kosaraju's algorithm to find all SCCs in the graph
 vector<vector<int>> kosaraju(int n, const vector<pair<int, int>>& edges) {
-    vector<list<int>> adj(n + 1), revAdj(n + 1); // Adjacency list and reverse adjacency list
-
-    // Construct adjacency list and reverse adjacency list from edges
-    for (const auto& edge : edges) {
-        adj[edge.first].push_back(edge.second);   // Original graph
-        revAdj[edge.second].push_back(edge.first); // Transposed graph
-    }
-
-    stack<int> finishStack;         // Stack to store finishing order of vertices
-    vector<bool> visited(n + 1, false); // Visited array to track visited vertices
-
-    // Perform first DFS to fill finishStack with vertices in finishing order
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1(i, adj, visited, finishStack);
-        }
-    }
-
-    fill(visited.begin(), visited.end(), false); // Reset visited array
-    vector<vector<int>> sccs; // Vector of vectors to store SCCs
-
-    // Process vertices in order of decreasing finish times (top of finishStack)
-    while (!finishStack.empty()) {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v]) {
-            vector<int> component; // Vector to store current SCC
-            dfs2(v, revAdj, visited, component); // Perform DFS on transposed graph
-            sccs.push_back(component); // Add current SCC to list of SCCs
-        }
-    }
+    vector<vector<int>> sccs = scc::kosaraju(n, edges); // Compute SCCs with the shared engine
 
     // Check if at least 50% of vertices are in the same SCC
     int maxComponentSize = 0;
@@ -100,7 +46,7 @@ vector<vector<int>> kosaraju(int n, const vector<pair<int, int>>& edges) {
 
 // Function executed by each client thread
 void* clientThread(void* arg) {
-    int sockfd = *((int*)arg); // Extract socket file descriptor from argument
+    int sockfd = (int)(intptr_t)arg; // Socket file descriptor passed by value
     char buffer[1024] = {0};   // Buffer to store incoming data
     string command;            // String to store parsed command
 
@@ -229,8 +175,14 @@ int main() {
             exit(EXIT_FAILURE); // Exit program
         }
 
+        // The fd goes by value: a pointer to new_socket would race with the next accept
         pthread_t tid; // Thread ID
-        pthread_create(&tid, NULL, clientThread, (void*)&new_socket); // Create new thread for client
+        if (pthread_create(&tid, NULL, clientThread, (void*)(intptr_t)new_socket) != 0) {
+            perror("pthread_create"); // Print error message if thread creation fails
+            close(new_socket); // Drop the client rather than leak its socket
+            continue;
+        }
+        pthread_detach(tid); // Nobody joins client threads; free their resources on exit
     }
 
     return 0; 
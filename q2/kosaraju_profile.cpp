@@ -1,180 +1,131 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include <deque>
-#include <stack>
 #include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include "perf_counters.hpp"
+#include "mem_counters.hpp"
+#include "../common/scc_engine.hpp"
 
 using namespace std;
 using namespace chrono;
-
-// DFS functions for list implementation
-void dfs1_list(int v, const vector<list<int>>& adj, vector<bool>& visited, stack<int>& finishStack) {
-    visited[v] = true;
-    for (int u : adj[v]) {
-        if (!visited[u]) {
-            dfs1_list(u, adj, visited, finishStack);
-        }
-    }
-    finishStack.push(v);
-}
-
-void dfs2_list(int v, const vector<list<int>>& revAdj, vector<bool>& visited, vector<int>& component) {
-    visited[v] = true;
-    component.push_back(v);
-    for (int u : revAdj[v]) {
-        if (!visited[u]) {
-            dfs2_list(u, revAdj, visited, component);
-        }
-    }
-}
-
-// Kosaraju's algorithm for list implementation
-vector<vector<int>> kosaraju_list(int n, const vector<pair<int, int>>& edges) {
-    vector<list<int>> adj(n + 1), revAdj(n + 1);
-    for (const auto& edge : edges) {
-        adj[edge.first].push_back(edge.second);
-        revAdj[edge.second].push_back(edge.first);
-    }
-
-    stack<int> finishStack;
-    vector<bool> visited(n + 1, false);
-    
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1_list(i, adj, visited, finishStack);
+using scc::Phase;
+using scc::PHASE_BUILD;
+
+// Phases of one Kosaraju run, as reported by the engine
+const int PHASE_COUNT = 3;
+const char* phase_names[PHASE_COUNT] = {"build", "dfs1", "dfs2"};
+
+// Collects wall time and, optionally, hardware counters and heap usage per phase
+struct PhaseRecorder {
+    PerfCounters* perf = nullptr;
+    bool mem = false;
+    long long ns[PHASE_COUNT] = {0, 0, 0};
+    PerfSample counters[PHASE_COUNT];
+    MemSample memory[PHASE_COUNT];
+    long long liveAtBegin = 0;
+    high_resolution_clock::time_point started;
+
+    void phaseBegin(Phase) {
+        if (mem) {
+            memcount::resetPeakRss();
+            liveAtBegin = memcount::live;
+            memcount::reset();
         }
+        if (perf) perf->start();
+        started = high_resolution_clock::now();
     }
 
-    fill(visited.begin(), visited.end(), false);
-    vector<vector<int>> sccs;
-
-    while (!finishStack.empty()) {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v]) {
-            vector<int> component;
-            dfs2_list(v, revAdj, visited, component);
-            sccs.push_back(component);
-        }
+    void phaseEnd(Phase phase) {
+        ns[phase] = duration_cast<nanoseconds>(high_resolution_clock::now() - started).count();
+        if (perf) counters[phase] = perf->stop();
+        if (mem) memory[phase] = memcount::sample(liveAtBegin);
     }
 
-    return sccs;
-}
+    void vertex(Phase, size_t) {}
+    void edge(Phase) {}
+};
 
-// DFS functions for deque implementation
-void dfs1_deque(int v, const vector<deque<int>>& adj, vector<bool>& visited, stack<int>& finishStack) {
-    visited[v] = true;
-    for (int u : adj[v]) {
-        if (!visited[u]) {
-            dfs1_deque(u, adj, visited, finishStack);
-        }
-    }
-    finishStack.push(v);
-}
-
-void dfs2_deque(int v, const vector<deque<int>>& revAdj, vector<bool>& visited, vector<int>& component) {
-    visited[v] = true;
-    component.push_back(v);
-    for (int u : revAdj[v]) {
-        if (!visited[u]) {
-            dfs2_deque(u, revAdj, visited, component);
-        }
-    }
+// The same engine traversal over each adjacency backend
+template <class Adjacency>
+vector<vector<int>> kosaraju_with(int n, const vector<pair<int, int>>& edges, PhaseRecorder* rec) {
+    if (rec) return scc::kosaraju<Adjacency>(n, edges, *rec);
+    return scc::kosaraju<Adjacency>(n, edges);
 }
 
-// Kosaraju's algorithm for deque implementation
-vector<vector<int>> kosaraju_deque(int n, const vector<pair<int, int>>& edges) {
-    vector<deque<int>> adj(n + 1), revAdj(n + 1);
-    for (const auto& edge : edges) {
-        adj[edge.first].push_back(edge.second);
-        revAdj[edge.second].push_back(edge.first);
-    }
-
-    stack<int> finishStack;
-    vector<bool> visited(n + 1, false);
-    
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1_deque(i, adj, visited, finishStack);
-        }
-    }
-
-    fill(visited.begin(), visited.end(), false);
-    vector<vector<int>> sccs;
-
-    while (!finishStack.empty()) {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v]) {
-            vector<int> component;
-            dfs2_deque(v, revAdj, visited, component);
-            sccs.push_back(component);
+// Set by --perf: collect hardware counters per phase
+bool use_perf = false;
+
+// The one counter group every benchmark reads, opened by main() for --perf;
+// null without it or when the counters are unavailable
+PerfCounters* perf_counters = nullptr;
+
+// Set by --mem: count heap allocations and peak RSS per phase
+bool use_mem = false;
+
+// Prints per-phase time and hardware counters normalized per edge
+void report_phases(const PhaseRecorder& rec, size_t m) {
+    double edges = m ? (double)m : 1.0;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        cout << "  " << setw(5) << phase_names[p] << ": " << rec.ns[p] / 1000 << " us";
+        if (rec.perf) {
+            static const char* names[PERF_EVENT_COUNT] = {"cycles", "instr", "cache-miss", "branch-miss"};
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                long long value = rec.counters[p].values[e];
+                cout << "  " << names[e] << "/edge ";
+                if (value < 0) cout << "n/a";
+                else cout << fixed << setprecision(3) << value / edges;
+            }
         }
-    }
-
-    return sccs;
-}
-
-// DFS functions for matrix implementation
-void dfs1_matrix(int v, const vector<vector<int>>& adj, vector<bool>& visited, stack<int>& finishStack) {
-    visited[v] = true;
-    for (int u = 0; u < adj[v].size(); ++u) {
-        if (adj[v][u] && !visited[u]) {
-            dfs1_matrix(u, adj, visited, finishStack);
+        if (rec.mem) {
+            const MemSample& mem = rec.memory[p];
+            cout << "  allocs " << mem.allocations
+                 << "  bytes " << mem.bytes
+                 << "  bytes/edge " << fixed << setprecision(1) << mem.bytes / edges
+                 << "  peak_live " << mem.peakLive
+                 << "  peak_rss_kb ";
+            if (mem.peakRssKb < 0) cout << "n/a";
+            else cout << mem.peakRssKb;
         }
+        cout << endl;
     }
-    finishStack.push(v);
-}
 
-void dfs2_matrix(int v, const vector<vector<int>>& revAdj, vector<bool>& visited, vector<int>& component) {
-    visited[v] = true;
-    component.push_back(v);
-    for (int u = 0; u < revAdj[v].size(); ++u) {
-        if (revAdj[v][u] && !visited[u]) {
-            dfs2_matrix(u, revAdj, visited, component);
+    if (rec.mem) {
+        long long bytes = 0, traversal = 0;
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            bytes += rec.memory[p].bytes;
+            if (p != PHASE_BUILD && rec.memory[p].peakLive > traversal) traversal = rec.memory[p].peakLive;
         }
+        // The adjacency built in the first phase stays live through both DFS passes
+        long long peak = rec.memory[PHASE_BUILD].peakLive + traversal;
+        cout << "  total: bytes/edge " << fixed << setprecision(1) << bytes / edges
+             << "  graph bytes/edge " << rec.memory[PHASE_BUILD].peakLive / edges
+             << "  peak_live/edge " << peak / edges << endl;
     }
 }
 
-// Kosaraju's algorithm for matrix implementation
-vector<vector<int>> kosaraju_matrix(int n, const vector<pair<int, int>>& edges) {
-    vector<vector<int>> adj(n + 1, vector<int>(n + 1, 0)), revAdj(n + 1, vector<int>(n + 1, 0));
-    for (const auto& edge : edges) {
-        adj[edge.first][edge.second] = 1;
-        revAdj[edge.second][edge.first] = 1;
-    }
-
-    stack<int> finishStack;
-    vector<bool> visited(n + 1, false);
-    
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1_matrix(i, adj, visited, finishStack);
-        }
-    }
+// Runs one implementation, printing its total time and (with --perf) the phase breakdown
+template <class Adjacency>
+void run_benchmark(const char* name, int n, const vector<pair<int, int>>& edges) {
+    PhaseRecorder rec;
+    rec.perf = perf_counters;
+    rec.mem = use_mem;
+    bool detailed = use_perf || use_mem;
 
-    fill(visited.begin(), visited.end(), false);
-    vector<vector<int>> sccs;
+    // Hand freed memory back so the RSS of one backend doesn't mask the next
+    if (use_mem) malloc_trim(0);
 
-    while (!finishStack.empty()) {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v]) {
-            vector<int> component;
-            dfs2_matrix(v, revAdj, visited, component);
-            sccs.push_back(component);
-        }
-    }
+    auto start = high_resolution_clock::now();
+    kosaraju_with<Adjacency>(n, edges, detailed ? &rec : nullptr);
+    auto end = high_resolution_clock::now();
+    cout << name << " implementation took " << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
 
-    return sccs;
+    if (detailed) report_phases(rec, edges.size());
 }
 
-// Function to profile both implementations
+// Function to profile the adjacency-list backends
 void profile_list_vs_deque() {
     int n = 10000;
     vector<pair<int, int>> edges;
@@ -183,15 +134,10 @@ void profile_list_vs_deque() {
     }
     edges.emplace_back(n, 1);
 
-    auto start = high_resolution_clock::now();
-    kosaraju_list(n, edges);
-    auto end = high_resolution_clock::now();
-    cout << "List implementation took " << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
-
-    start = high_resolution_clock::now();
-    kosaraju_deque(n, edges);
-    end = high_resolution_clock::now();
-    cout << "Deque implementation took " << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
+    run_benchmark<scc::ListAdjacency>("List", n, edges);
+    run_benchmark<scc::DequeAdjacency>("Deque", n, edges);
+    run_benchmark<scc::VectorAdjacency>("Vector", n, edges);
+    run_benchmark<scc::CsrAdjacency>("CSR", n, edges);
 }
 
 // Function to profile both graph realizations
@@ -203,19 +149,38 @@ void profile_matrix_vs_list() {
     }
     edges.emplace_back(n, 1);
 
-    auto start = high_resolution_clock::now();
-    kosaraju_matrix(n, edges);
-    auto end = high_resolution_clock::now();
-    cout << "Matrix implementation took " << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
-
-    start = high_resolution_clock::now();
-    kosaraju_list(n, edges);
-    end = high_resolution_clock::now();
-    cout << "List implementation took " << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
+    run_benchmark<scc::BitMatrixAdjacency>("Matrix", n, edges);
+    run_benchmark<scc::ListAdjacency>("List", n, edges);
 }
 
-int main() {
-    cout << "Profiling list vs deque:" << endl;
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--perf") == 0) {
+            use_perf = true;
+        } else if (strcmp(argv[i], "--mem") == 0) {
+            use_mem = true;
+            memcount::enabled = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--perf] [--mem]" << endl;
+            return 1;
+        }
+    }
+
+    unique_ptr<PerfCounters> perf;
+    if (use_perf) {
+        perf.reset(new PerfCounters());
+        if (perf->available()) {
+            perf_counters = perf.get();
+        } else {
+            cout << "Hardware counters unavailable (perf_event_open failed), reporting time only" << endl;
+        }
+    }
+
+    if (use_mem && !memcount::resetPeakRss()) {
+        cout << "Cannot reset peak RSS (/proc/self/clear_refs), peak_rss_kb is process-wide" << endl;
+    }
+
+    cout << "Profiling list vs deque vs vector vs CSR:" << endl;
     profile_list_vs_deque();
     cout << endl;
 
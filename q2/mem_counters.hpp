@@ -0,0 +1,108 @@
+#ifndef MEM_COUNTERS_HPP
+#define MEM_COUNTERS_HPP
+
+// Interposed global allocator that counts allocations, bytes and peak live bytes,
+// plus helpers to read and reset the process peak RSS. It replaces operator new
+// and delete, so include it from exactly one translation unit. Nothing is
+// counted until memcount::enabled is set; before that the operators cost one
+// branch over malloc and free.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+
+// Allocation totals since the counters were last reset
+struct MemSample {
+    long long allocations = 0;  // calls to operator new
+    long long bytes = 0;        // bytes handed out, including allocator slack
+    long long peakLive = 0;     // highest live heap bytes above the phase start
+    long long peakRssKb = -1;   // VmHWM at phase end, -1 if unreadable
+};
+
+namespace memcount {
+    inline bool enabled = false;   // set once, before the first phase
+    inline long long allocations = 0;
+    inline long long bytes = 0;
+    inline long long live = 0;
+    inline long long peak = 0;
+
+    // Starts a phase: zeroes the counters and makes the current live size the baseline
+    inline void reset() {
+        allocations = 0;
+        bytes = 0;
+        peak = live;
+    }
+
+    // Resets the kernel's peak RSS watermark; returns false when not permitted
+    inline bool resetPeakRss() {
+        FILE* f = fopen("/proc/self/clear_refs", "w");
+        if (!f) return false;
+        bool ok = fputs("5", f) >= 0;
+        return (fclose(f) == 0) && ok;
+    }
+
+    // Reads VmHWM (peak RSS) in kB from /proc/self/status
+    inline long long peakRssKb() {
+        FILE* f = fopen("/proc/self/status", "r");
+        if (!f) return -1;
+        char line[256];
+        long long kb = -1;
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = atoll(line + 6);
+                break;
+            }
+        }
+        fclose(f);
+        return kb;
+    }
+
+    // Counters accumulated since reset(), relative to the given live baseline
+    inline MemSample sample(long long baseline) {
+        MemSample s;
+        s.allocations = allocations;
+        s.bytes = bytes;
+        s.peakLive = peak - baseline;
+        s.peakRssKb = peakRssKb();
+        return s;
+    }
+}
+
+void* operator new(std::size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    if (!memcount::enabled) return p;
+    long long usable = (long long)malloc_usable_size(p);
+    ++memcount::allocations;
+    memcount::bytes += usable;
+    memcount::live += usable;
+    if (memcount::live > memcount::peak) memcount::peak = memcount::live;
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    // Blocks from before counting began lower live too; phases only use differences
+    if (memcount::enabled) memcount::live -= (long long)malloc_usable_size(p);
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+#endif // MEM_COUNTERS_HPP
@@ -0,0 +1,103 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware counters collected around a benchmark phase
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+// Values read for one phase; a counter that could not be opened is reported as -1
+struct PerfSample {
+    long long values[PERF_EVENT_COUNT];
+
+    PerfSample() {
+        for (int i = 0; i < PERF_EVENT_COUNT; ++i) values[i] = -1;
+    }
+};
+
+// Thin wrapper over a perf_event_open group counting the calling thread in user space.
+// When the kernel refuses (no PMU, container, perf_event_paranoid) the counters are
+// simply unavailable and every sample reads as -1.
+class PerfCounters {
+public:
+    PerfCounters() {
+        static const uint64_t configs[PERF_EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = (leader() < 0) ? 1 : 0; // group members follow the leader
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader(), 0);
+        }
+    }
+
+    ~PerfCounters() {
+        for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (fds[i] >= 0) close(fds[i]);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // True when at least one counter could be opened
+    bool available() const {
+        return leader() >= 0;
+    }
+
+    // Resets and enables the group
+    void start() {
+        if (!available()) return;
+        ioctl(leader(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    // Disables the group and returns the counts since start()
+    PerfSample stop() {
+        PerfSample sample;
+        if (!available()) return sample;
+        ioctl(leader(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+            long long value;
+            if (fds[i] >= 0 && read(fds[i], &value, sizeof(value)) == sizeof(value)) {
+                sample.values[i] = value;
+            }
+        }
+        return sample;
+    }
+
+private:
+    // The first counter that opened leads the group
+    int leader() const {
+        for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (fds[i] >= 0) return fds[i];
+        }
+        return -1;
+    }
+
+    int fds[PERF_EVENT_COUNT] = {-1, -1, -1, -1};
+};
+
+#endif // PERF_COUNTERS_HPP
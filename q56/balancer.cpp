@@ -0,0 +1,99 @@
+#include "balancer.hpp"
+#include <sstream>
+
+// A loop must be this much (in permille of busy time) hotter than another
+// before connections move; keeps handoffs from flapping between similar loops
+static const int HANDOFF_MARGIN = 250;
+
+// Queued output counts as load too, one permille per 64 KiB, capped
+static const int QUEUE_SCORE_SHIFT = 16;
+static const int QUEUE_SCORE_MAX = 500;
+
+LoadBalancer balancer;
+
+LoadBalancer::LoadBalancer() : loopCount(0), handoffs(0) {
+    for (int i = 0; i < MAX_LOOPS; ++i) lastBusyNs[i] = 0;
+}
+
+// Makes a loop a handoff target
+void LoadBalancer::registerLoop(int index, void* reactor) {
+    if (index < 0 || index >= MAX_LOOPS) return;
+    loads[index].reactor.store(reactor, std::memory_order_release);
+    int count = loopCount.load();
+    while (count < index + 1 && !loopCount.compare_exchange_weak(count, index + 1)) {
+    }
+}
+
+LoopLoad& LoadBalancer::load(int index) {
+    return loads[index];
+}
+
+// Folds the busy time of the last interval into the smoothed load
+void LoadBalancer::sample(int index, uint64_t intervalNs, int connections, uint64_t queuedBytes) {
+    LoopLoad& l = loads[index];
+    uint64_t busy = l.busyNs.load(std::memory_order_relaxed);
+    uint64_t delta = busy - lastBusyNs[index];
+    lastBusyNs[index] = busy;
+
+    int now = intervalNs ? (int)(delta * 1000 / intervalNs) : 0;
+    if (now > 1000) now = 1000;
+    // Half old, half new: a burst shows up in one tick and fades in a few
+    int smoothed = (l.busyPermille.load(std::memory_order_relaxed) + now) / 2;
+    l.busyPermille.store(smoothed, std::memory_order_relaxed);
+    l.connections.store(connections, std::memory_order_relaxed);
+    l.queuedBytes.store(queuedBytes, std::memory_order_relaxed);
+}
+
+int LoadBalancer::score(int index) const {
+    const LoopLoad& l = loads[index];
+    uint64_t queued = l.queuedBytes.load(std::memory_order_relaxed) >> QUEUE_SCORE_SHIFT;
+    return l.busyPermille.load(std::memory_order_relaxed) + (int)(queued < QUEUE_SCORE_MAX ? queued : QUEUE_SCORE_MAX);
+}
+
+// A loop clearly less loaded than index, or -1 if none is
+int LoadBalancer::colderLoop(int index) const {
+    int count = loopCount.load(std::memory_order_acquire);
+    int best = -1, bestScore = score(index) - HANDOFF_MARGIN;
+    for (int i = 0; i < count; ++i) {
+        if (i == index || !loads[i].reactor.load(std::memory_order_acquire)) continue;
+        int s = score(i);
+        if (s < bestScore) {
+            best = i;
+            bestScore = s;
+        }
+    }
+    return best;
+}
+
+void LoadBalancer::handedOff() {
+    handoffs.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Plain text lines for the Stats command
+std::string LoadBalancer::report() const {
+    std::stringstream out;
+    int count = loopCount.load();
+    if (count <= 1) return "";
+    out << "handoffs " << handoffs.load() << "\n";
+    for (int i = 0; i < count; ++i) {
+        const LoopLoad& l = loads[i];
+        out << "loop " << i << " connections " << l.connections.load() << " busy_permille " << l.busyPermille.load()
+            << " queued_bytes " << l.queuedBytes.load() << "\n";
+    }
+    return out.str();
+}
+
+// Prometheus lines for the metrics listener
+std::string LoadBalancer::prometheus() const {
+    std::stringstream out;
+    int count = loopCount.load();
+    if (count <= 1) return "";
+    out << "scc_loop_handoffs_total " << handoffs.load() << "\n";
+    for (int i = 0; i < count; ++i) {
+        const LoopLoad& l = loads[i];
+        out << "scc_loop_connections{loop=\"" << i << "\"} " << l.connections.load() << "\n";
+        out << "scc_loop_busy_ratio{loop=\"" << i << "\"} " << l.busyPermille.load() / 1000.0 << "\n";
+        out << "scc_loop_queued_bytes{loop=\"" << i << "\"} " << l.queuedBytes.load() << "\n";
+    }
+    return out.str();
+}
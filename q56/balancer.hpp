@@ -0,0 +1,61 @@
+#ifndef BALANCER_HPP
+#define BALANCER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Most event loops the balancer tracks
+const int MAX_LOOPS = 64;
+
+// How often each loop republishes its load and considers a handoff
+const int BALANCE_TICK_MS = 100;
+
+// Load one event loop publishes for the others; written only by its own thread
+struct LoopLoad {
+    std::atomic<void*> reactor{nullptr};
+    std::atomic<int> connections{0};
+    std::atomic<uint64_t> queuedBytes{0};   // output waiting on this loop's connections
+    std::atomic<uint64_t> busyNs{0};        // time spent in handlers, ever
+    std::atomic<int> busyPermille{0};       // share of recent ticks spent busy, smoothed
+};
+
+// Shared view of every loop's load, used to steer accepts and hand idle
+// connections from hot loops to cold ones
+class LoadBalancer {
+public:
+    LoadBalancer();
+
+    // Makes a loop a handoff target
+    void registerLoop(int index, void* reactor);
+
+    LoopLoad& load(int index);
+
+    // Called by loop index every tick: folds the busy time of the last
+    // intervalNs into its smoothed load and publishes its queue depth
+    void sample(int index, uint64_t intervalNs, int connections, uint64_t queuedBytes);
+
+    // A loop clearly less loaded than index, or -1 if none is
+    int colderLoop(int index) const;
+
+    // Counts a connection moved to another loop
+    void handedOff();
+
+    // Plain text lines for the Stats command
+    std::string report() const;
+
+    // Prometheus lines for the metrics listener
+    std::string prometheus() const;
+
+private:
+    int score(int index) const;
+
+    LoopLoad loads[MAX_LOOPS];
+    uint64_t lastBusyNs[MAX_LOOPS];   // each entry only touched by its loop
+    std::atomic<int> loopCount;
+    std::atomic<uint64_t> handoffs;
+};
+
+extern LoadBalancer balancer;
+
+#endif // BALANCER_HPP
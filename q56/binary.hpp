@@ -0,0 +1,65 @@
+#ifndef BINARY_HPP
+#define BINARY_HPP
+
+// Binary protocol for bulk graph transfer. A client enters it by sending the
+// text command "Binary"; after the "Binary mode" reply both directions carry
+// frames: a uint32 payload length, then the payload, whose first byte is an
+// opcode.
+//
+//   OP_NEWGRAPH  n, m, then m (u, v) pairs  ->  OP_NEWGRAPH
+//   OP_KOSARAJU                             ->  OP_KOSARAJU, n, components, then
+//                                               the component of vertices 1..n
+//   OP_COMMAND   a text command             ->  OP_COMMAND, its text reply
+//
+// Every number is a little-endian uint32, and components are numbered from 0
+// in the order the text reply lists them. A request that cannot be served is
+// answered with OP_ERROR and a message.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum BinaryOp : uint8_t {
+    OP_NEWGRAPH = 1,
+    OP_KOSARAJU = 2,
+    OP_COMMAND = 3,
+    OP_ERROR = 0xff,
+};
+
+// Bytes of the length prefix
+const size_t FRAME_HEADER_BYTES = 4;
+
+inline uint32_t getU32(const char* p) {
+    const unsigned char* b = (const unsigned char*)p;
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+inline void putU32(char* p, uint32_t v) {
+    p[0] = (char)v;
+    p[1] = (char)(v >> 8);
+    p[2] = (char)(v >> 16);
+    p[3] = (char)(v >> 24);
+}
+
+// Writes the length prefix and opcode of a frame with bodyBytes after the opcode
+inline void putFrameHeader(char* frame, BinaryOp op, size_t bodyBytes) {
+    putU32(frame, (uint32_t)(1 + bodyBytes));
+    frame[FRAME_HEADER_BYTES] = (char)op;
+}
+
+// A frame with room for bodyBytes after the opcode, which the caller fills in
+// from FRAME_HEADER_BYTES + 1 on
+inline std::string binaryFrame(BinaryOp op, size_t bodyBytes) {
+    std::string frame(FRAME_HEADER_BYTES + 1 + bodyBytes, '\0');
+    putFrameHeader(&frame[0], op, bodyBytes);
+    return frame;
+}
+
+// A frame carrying text, as OP_COMMAND and OP_ERROR replies do
+inline std::string binaryFrame(BinaryOp op, const std::string& text) {
+    std::string frame = binaryFrame(op, text.size());
+    frame.replace(FRAME_HEADER_BYTES + 1, text.size(), text);
+    return frame;
+}
+
+#endif // BINARY_HPP
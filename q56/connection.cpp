@@ -0,0 +1,357 @@
+#include "connection.hpp"
+#include "binary.hpp"
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+// Replies shorter than this are appended to the last queued buffer
+static const size_t COALESCE_BYTES = 64 << 10;
+
+// Buffers handed to one sendmsg()
+static const int MAX_IOV = 64;
+
+// Most memory the buffer pool keeps
+static const size_t POOL_BYTES = 256 << 20;
+
+static std::mutex poolMutex;
+static std::vector<std::string> pool;
+static size_t pooledBytes = 0;
+
+// Puts fd in non-blocking mode
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Reads until the socket would block or the budget is spent, appending to c.in
+bool readAvailable(Connection& c, size_t& bytesRead, bool& drained) {
+    char buffer[65536];
+    bytesRead = 0;
+    drained = false;
+    while (bytesRead < READ_BUDGET_BYTES) {
+        ssize_t got = read(c.fd, buffer, sizeof(buffer));
+        if (got > 0) {
+            c.in.append(buffer, got);
+            bytesRead += got;
+            continue;
+        }
+        if (got == 0) return false;  // peer closed
+        if (errno == EINTR) continue;
+        drained = errno == EAGAIN || errno == EWOULDBLOCK;
+        return drained;
+    }
+    return true;
+}
+
+// Counts the whitespace-separated tokens in [p, end)
+static long long countTokens(const char* p, const char* end) {
+    long long tokens = 0;
+    bool inToken = false;
+    for (; p < end; ++p) {
+        bool space = isspace((unsigned char)*p);
+        if (!space && !inToken) ++tokens;
+        inToken = !space;
+    }
+    return tokens;
+}
+
+// Copies the next token of [p, end) into token and moves p past it
+static bool nextToken(const char*& p, const char* end, std::string& token) {
+    while (p < end && isspace((unsigned char)*p)) ++p;
+    const char* first = p;
+    while (p < end && !isspace((unsigned char)*p)) ++p;
+    token.assign(first, p - first);
+    return p > first;
+}
+
+// Edge endpoints a request's first line announces beyond those on the line
+static long long numbersExpected(const char* p, const char* end) {
+    std::string token;
+    if (!nextToken(p, end, token) || token != "Newgraph") return 0;
+    std::string vertices, edges;
+    if (!nextToken(p, end, vertices) || !nextToken(p, end, edges)) return 0;
+    char* tail;
+    long long m = strtoll(edges.c_str(), &tail, 10);
+    if (*tail || m <= 0) return 0;
+    return 2 * m - countTokens(p, end);
+}
+
+// Drops the input already cut into requests, once per batch of them
+static void compact(std::string& in, RequestFramer& f) {
+    if (f.start == 0) return;
+    in.erase(0, f.start);
+    f.lineStart -= f.start;
+    f.scanned -= f.start;
+    f.start = 0;
+}
+
+// Cuts the next length-prefixed frame out of in
+static bool nextFrame(std::string& in, RequestFramer& f, Request& request) {
+    size_t available = in.size() - f.start;
+    if (available >= FRAME_HEADER_BYTES) {
+        uint32_t length = getU32(in.data() + f.start);
+        if (length > MAX_REQUEST_BYTES) {
+            f.overflow = true;
+        } else if (available - FRAME_HEADER_BYTES >= length) {
+            request.binary = true;
+            request.body.assign(in.data() + f.start + FRAME_HEADER_BYTES, length);
+            f.start = f.lineStart = f.scanned = f.start + FRAME_HEADER_BYTES + length;
+            return true;
+        }
+    }
+    compact(in, f);
+    return false;
+}
+
+// Cuts the next complete request out of in, without its line ending
+bool nextRequest(std::string& in, RequestFramer& f, Request& request) {
+    if (f.binary) return nextFrame(in, f, request);
+    while (true) {
+        const char* data = in.data();
+        const void* newline = memchr(data + f.scanned, '\n', in.size() - f.scanned);
+        if (!newline) {
+            f.scanned = in.size();
+            if (in.size() - f.start > MAX_REQUEST_BYTES) f.overflow = true;
+            compact(in, f);
+            return false;
+        }
+        size_t end = (const char*)newline - data;
+        const char* line = data + f.lineStart;
+        if (f.numbersLeft < 0) {
+            // Blank lines between requests are skipped
+            if (countTokens(line, data + end) == 0) {
+                f.start = f.lineStart = f.scanned = end + 1;
+                continue;
+            }
+            f.numbersLeft = numbersExpected(line, data + end);
+        } else {
+            f.numbersLeft -= countTokens(line, data + end);
+        }
+        f.lineStart = f.scanned = end + 1;
+        if (f.numbersLeft > 0) continue;
+
+        size_t length = end - f.start;
+        if (length > 0 && data[end - 1] == '\r') --length;
+        request.binary = false;
+        request.body.assign(data + f.start, length);
+        f.start = end + 1;
+        f.numbersLeft = -1;
+
+        // Whatever follows "Binary" is framed, even if it was sent with it
+        const char* p = request.body.data();
+        std::string command;
+        if (nextToken(p, p + request.body.size(), command) && command == "Binary") f.binary = true;
+        return true;
+    }
+}
+
+// An empty buffer for a large reply, recycled if one is pooled
+std::string takeBuffer() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (pool.empty()) return std::string();
+    std::string buffer = std::move(pool.back());
+    pool.pop_back();
+    pooledBytes -= buffer.capacity();
+    return buffer;
+}
+
+// Returns a buffer whose contents are no longer needed; large ones are pooled
+// so their pages need not be faulted in again
+void recycleBuffer(std::string&& buffer) {
+    if (buffer.capacity() < ZEROCOPY_BYTES) return;
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (pooledBytes + buffer.capacity() > POOL_BYTES) return;
+    pooledBytes += buffer.capacity();
+    pool.push_back(std::move(buffer));
+}
+
+void enableZerocopy(Connection& c) {
+    int one = 1;
+    c.zerocopy = setsockopt(c.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+}
+
+// Completions name ranges of zero-copy sends; a TCP socket completes them in
+// order, so the end of the latest range covers every send before it
+void reapZerocopy(Connection& c) {
+    while (true) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(c.fd, &msg, MSG_ERRQUEUE) < 0) break;
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr) continue;
+            const struct sock_extended_err* err = (const struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            c.completedSends = err->ee_data + 1;
+            // The kernel copied after all, as it does on loopback; pinning
+            // pages would only add cost, so later sends copy outright
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) c.zerocopy = false;
+        }
+    }
+    while (!c.held.empty() && (int32_t)(c.held.front().lastSend - c.completedSends) < 0) {
+        recycleBuffer(std::move(c.held.front().data));
+        c.held.pop_front();
+    }
+}
+
+bool isLocal(const Connection& c) {
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    return getsockname(c.fd, (struct sockaddr*)&address, &length) == 0 && address.ss_family == AF_UNIX;
+}
+
+// Sends text with the descriptors attached, all of it in one call
+static bool sendWithFds(int fd, const std::string& text, const int* fds, int count) {
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {const_cast<char*>(text.data()), text.size()};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)text.size();
+}
+
+// Session slots in use, on every loop
+static std::atomic<int> sharedSessions(0);
+
+bool reserveSharedSession() {
+    if (sharedSessions.fetch_add(1, std::memory_order_relaxed) < SHM_MAX_SESSIONS) return true;
+    sharedSessions.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool attachSharedMemory(Connection& c, size_t ringBytes, const std::string& reply) {
+    SharedSession* s = new SharedSession();
+    s->mappedBytes = shmMappedBytes(ringBytes);
+    int memfd = memfd_create("scc-rings", MFD_CLOEXEC);
+    if (memfd >= 0 && ftruncate(memfd, s->mappedBytes) == 0) {
+        // Populated up front: faulting the rings in while traffic laps them
+        // the first time would cost more than the copies they save
+        void* base = mmap(nullptr, s->mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd, 0);
+        if (base != MAP_FAILED) s->base = static_cast<char*>(base);
+    }
+    // The client blocks on its bell; the reactor must not block on its own
+    s->serverBell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    s->clientBell = eventfd(0, EFD_CLOEXEC);
+    c.shm = s;
+
+    int fds[3] = {memfd, s->serverBell, s->clientBell};
+    bool ok = s->base && s->serverBell >= 0 && s->clientBell >= 0 && sendWithFds(c.fd, reply, fds, 3);
+    // The mapping keeps the memory; the client has its own descriptor
+    if (memfd >= 0) close(memfd);
+    if (!ok) {
+        detachSharedMemory(c);
+        return false;
+    }
+    shmRings(s->base, ringBytes, s->requests, s->replies);
+    return true;
+}
+
+void detachSharedMemory(Connection& c) {
+    SharedSession* s = c.shm;
+    if (!s) return;
+    if (s->base) munmap(s->base, s->mappedBytes);
+    if (s->serverBell >= 0) close(s->serverBell);
+    if (s->clientBell >= 0) close(s->clientBell);
+    delete s;
+    c.shm = nullptr;
+    sharedSessions.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Appends a reply to the output queue; small replies share one buffer
+void queueOutput(Connection& c, std::string data) {
+    if (data.empty()) return;
+    c.outBytes += data.size();
+    // Appending leaves the bytes before outOffset where they are
+    if (!c.out.empty() && c.out.back().size() + data.size() <= COALESCE_BYTES) {
+        c.out.back() += data;
+        return;
+    }
+    c.out.push_back(std::move(data));
+}
+
+// Writes queued output until it is gone or the socket would block
+bool flushOutput(Connection& c, size_t& bytesWritten) {
+    bytesWritten = 0;
+    bool zerocopy = c.zerocopy;
+    while (!c.out.empty()) {
+        bool large = zerocopy && c.out.front().size() - c.outOffset >= ZEROCOPY_BYTES;
+        struct iovec iov[MAX_IOV];
+        int count = 0;
+        size_t offset = c.outOffset;
+        for (auto it = c.out.begin(); it != c.out.end() && count < (large ? 1 : MAX_IOV); ++it, ++count) {
+            iov[count].iov_base = (void*)(it->data() + offset);
+            iov[count].iov_len = it->size() - offset;
+            offset = 0;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(c.fd, &msg, MSG_NOSIGNAL | (large ? MSG_ZEROCOPY : 0));
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            // Out of memory for pinning pages; this flush copies instead
+            if (large && errno == ENOBUFS) {
+                zerocopy = false;
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (large) {
+            c.frontZerocopied = true;
+            c.frontSend = c.nextSend++;
+        }
+        bytesWritten += sent;
+        c.outBytes -= sent;
+        // Drop the buffers that went out whole
+        size_t left = sent;
+        while (left > 0) {
+            size_t rest = c.out.front().size() - c.outOffset;
+            if (left < rest) {
+                c.outOffset += left;
+                break;
+            }
+            left -= rest;
+            // The kernel may still read a zero-copy buffer's pages
+            if (c.frontZerocopied) {
+                c.held.push_back(HeldBuffer{c.frontSend, std::move(c.out.front())});
+                c.frontZerocopied = false;
+            } else {
+                recycleBuffer(std::move(c.out.front()));
+            }
+            c.out.pop_front();
+            c.outOffset = 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,144 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include "shm.hpp"
+#include "timer.hpp"
+
+// Stop reading from a client once this much output is queued for it...
+const size_t OUTPUT_HIGH_WATERMARK = 4 << 20;
+// ...and resume when it drains below this
+const size_t OUTPUT_LOW_WATERMARK = 1 << 20;
+
+// Replies at least this large are sent with MSG_ZEROCOPY where the socket
+// allows it, and their buffers are pooled for reuse
+const size_t ZEROCOPY_BYTES = 256 << 10;
+
+// Largest request accepted, enough for a binary graph of 30M edges; a client
+// that sends more without finishing one is disconnected
+const size_t MAX_REQUEST_BYTES = 256 << 20;
+
+// Most input taken from one client per readiness event; the rest waits for
+// the next round, so one busy sender cannot hold its loop
+const size_t READ_BUDGET_BYTES = 1 << 20;
+
+// One request cut out of the input
+struct Request {
+    bool binary = false;   // a binary frame's payload (see binary.hpp), not a text command
+    std::string body;
+};
+
+// Where the next request is being cut out of an input buffer. A request is a
+// line, except that Newgraph runs on over as many lines as its m edges take.
+// Scanning resumes where it stopped, so a large request that arrives in many
+// pieces is looked at once. After a "Binary" line, requests are
+// length-prefixed frames instead.
+struct RequestFramer {
+    size_t start = 0;            // first byte of the request being framed
+    size_t lineStart = 0;        // first byte of its current line
+    size_t scanned = 0;          // bytes searched for a newline so far
+    long long numbersLeft = -1;  // edge endpoints still expected, -1 before the first line
+    bool overflow = false;       // the request grew past MAX_REQUEST_BYTES
+    bool binary = false;         // the client switched to binary frames
+};
+
+// A sent buffer the kernel may still read from, kept until the zero-copy
+// send lastSend completes
+struct HeldBuffer {
+    uint32_t lastSend;
+    std::string data;
+};
+
+// Rings of a connection that switched to shared memory (see shm.hpp)
+struct SharedSession {
+    char* base = nullptr;       // the memfd's mapping
+    size_t mappedBytes = 0;
+    ShmRing requests;           // read here
+    ShmRing replies;            // written here
+    int serverBell = -1;        // rung by the client, watched by the reactor
+    int clientBell = -1;        // rung here for the client
+    std::string pending;        // a reply waiting for room in the reply ring
+};
+
+// Per-connection state, owned by the reactor thread
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;               // unique within its loop, unlike fd numbers
+    std::string in;                // bytes read but not processed yet
+    RequestFramer framer;          // how far in has been split into requests
+    std::deque<std::string> out;   // queued replies
+    size_t outOffset = 0;          // bytes of out.front() already sent
+    size_t outBytes = 0;           // queued bytes not sent yet
+    bool wantWrite = false;        // write readiness is being watched
+    bool readPaused = false;       // reading stopped for backpressure
+    bool inFlight = false;         // requests are with the worker pool
+    bool inputClosed = false;      // the peer finished sending while one was
+    uint64_t busyNs = 0;           // handler time spent on it this balancing tick
+    uint64_t lastInputNs = 0;      // when input last arrived, for idle reaping
+    TimerId idleTimer = 0;         // checks for idleness, rearmed lazily
+    TimerId writeTimer = 0;        // deadline for queued output to drain
+    bool zerocopy = false;         // large buffers go out with MSG_ZEROCOPY
+    bool frontZerocopied = false;  // out.front() went out partly zero-copy
+    uint32_t frontSend = 0;        // ...and this was its last such send
+    uint32_t nextSend = 0;         // number the kernel gives the next zero-copy send
+    uint32_t completedSends = 0;   // zero-copy sends before this one have completed
+    std::deque<HeldBuffer> held;   // sent buffers awaiting completion
+    SharedSession* shm = nullptr;  // requests come through shared memory instead
+};
+
+// Puts fd in non-blocking mode
+bool setNonBlocking(int fd);
+
+// Reads until the socket would block or READ_BUDGET_BYTES have been read,
+// appending to c.in; drained tells which. Returns false when the peer closed
+// the connection or on error.
+bool readAvailable(Connection& c, size_t& bytesRead, bool& drained);
+
+// Cuts the next complete request out of in, without its line ending or frame
+// header. Returns false when none is complete yet, after dropping the input
+// already consumed.
+bool nextRequest(std::string& in, RequestFramer& framer, Request& request);
+
+// An empty buffer for a large reply, with the capacity of a recycled one if
+// any is pooled. Safe from any thread.
+std::string takeBuffer();
+
+// Returns a buffer whose contents are no longer needed; large ones are pooled
+void recycleBuffer(std::string&& buffer);
+
+// Turns on MSG_ZEROCOPY for the connection's socket if the kernel supports it
+void enableZerocopy(Connection& c);
+
+// Collects zero-copy completions from the socket's error queue and recycles
+// the buffers they release
+void reapZerocopy(Connection& c);
+
+// Whether the connection's peer is on this host, over a Unix domain socket
+bool isLocal(const Connection& c);
+
+// Takes one of the SHM_MAX_SESSIONS session slots; false if none is free.
+// detachSharedMemory() gives it back.
+bool reserveSharedSession();
+
+// Creates rings of ringBytes and their eventfds, and hands them to the client
+// with the text reply; c.out must be empty and a slot reserved. False, with
+// c.shm left null and the slot released, if any of it fails.
+bool attachSharedMemory(Connection& c, size_t ringBytes, const std::string& reply);
+
+// Unmaps the rings and closes the eventfds; the caller has stopped watching
+// serverBell
+void detachSharedMemory(Connection& c);
+
+// Appends a reply to the output queue; small replies share one buffer
+void queueOutput(Connection& c, std::string data);
+
+// Writes queued output until it is gone or the socket would block, several
+// buffers per system call. A large buffer on a zero-copy socket goes out on
+// its own with MSG_ZEROCOPY and is held until the kernel is done with it.
+// Returns false on a write error.
+bool flushOutput(Connection& c, size_t& bytesWritten);
+
+#endif // CONNECTION_HPP
@@ -0,0 +1,222 @@
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+// Coroutine handlers on top of the reactor: a client can be served by
+// sequential code that co_awaits its reads and writes, and between events
+// only the coroutine frame is kept, not a thread and its stack. Needs a
+// C++20 build (-std=c++20); otherwise this header declares nothing.
+
+#if defined(__cpp_impl_coroutine)
+
+#include <cerrno>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "reactor.hpp"
+
+// Coroutine that starts when called and runs in steps on the loop thread
+// until it returns; its frame frees itself at the end
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// A non-blocking fd owned by a coroutine: registered with the reactor the
+// first time an operation has to wait, removed and closed when destroyed.
+// One operation at a time is awaited; it is retried each time the reactor
+// reports the fd ready and the coroutine resumes once it completes.
+// Loop thread only.
+class AsyncFd {
+public:
+    AsyncFd(void* reactor, int fd) : reactor(reactor), fd(fd), interest(0), drained(true), rearm(false), pending(nullptr) {}
+
+    ~AsyncFd() {
+        if (interest) removeFdFromReactor(reactor, fd);
+        close(fd);
+    }
+
+    int get() const { return fd; }
+
+    // An awaited operation, suspending only if it would block
+    class Operation {
+    public:
+        explicit Operation(AsyncFd& owner, int events) : owner(owner), events(events) {}
+        virtual ~Operation() {}
+
+        bool await_ready() { return tryFirst() && attempt(); }
+
+        // Resumes at once if the fd cannot be watched; the result is then an error
+        bool await_suspend(std::coroutine_handle<> handle) {
+            waiter = handle;
+            if (owner.wait(this)) return true;
+            fail();
+            return false;
+        }
+
+    protected:
+        friend class AsyncFd;
+
+        // Whether to try before the reactor reports the fd ready
+        virtual bool tryFirst() { return true; }
+
+        // Makes progress; false while the operation would block
+        virtual bool attempt() = 0;
+        virtual void fail() = 0;
+
+        AsyncFd& owner;
+        int events;   // POLLER_* readiness that lets it progress
+        std::coroutine_handle<> waiter;
+    };
+
+    // Waits for input, then reads until the socket is drained or budget bytes
+    // are in, appending to in. Yields the bytes read, 0 at end of stream, -1 on
+    // error. Either way the next read waits for the reactor to report input,
+    // so a client that always has another request ready cannot keep the loop
+    // to itself; input left unread raises no new edge, so the fd is re-armed.
+    class ReadOp : public Operation {
+    public:
+        ReadOp(AsyncFd& owner, std::string& in, size_t budget)
+            : Operation(owner, POLLER_READ), in(in), budget(budget), result(0) {}
+        ssize_t await_resume() const { return result; }
+
+    protected:
+        bool tryFirst() override { return !owner.drained; }
+
+        bool attempt() override {
+            char buffer[16384];
+            ssize_t total = 0;
+            while (true) {
+                if ((size_t)total >= budget) {
+                    owner.drained = true;
+                    owner.rearm = true;
+                    result = total;
+                    return true;
+                }
+                ssize_t got = ::read(owner.fd, buffer, sizeof(buffer));
+                if (got > 0) {
+                    in.append(buffer, got);
+                    total += got;
+                    continue;
+                }
+                if (got < 0 && errno == EINTR) continue;
+                owner.drained = got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                if (owner.drained && total == 0) return false;
+                // Input that came with the EOF or error is handed over first;
+                // the next read reports the end again
+                result = total > 0 ? total : got;
+                return true;
+            }
+        }
+        void fail() override { result = -1; }
+
+    private:
+        std::string& in;
+        size_t budget;
+        ssize_t result;
+    };
+
+    // Writes all of data, waiting for room as often as needed. Yields len, or
+    // -1 on error.
+    class WriteOp : public Operation {
+    public:
+        WriteOp(AsyncFd& owner, const char* data, size_t len)
+            : Operation(owner, POLLER_WRITE), data(data), len(len), offset(0), result(0) {}
+        ssize_t await_resume() const { return result; }
+
+    protected:
+        bool attempt() override {
+            while (offset < len) {
+                ssize_t sent = ::send(owner.fd, data + offset, len - offset, MSG_NOSIGNAL);
+                if (sent > 0) {
+                    offset += sent;
+                    continue;
+                }
+                if (sent < 0 && errno == EINTR) continue;
+                if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+                result = -1;
+                return true;
+            }
+            result = (ssize_t)len;
+            return true;
+        }
+        void fail() override { result = -1; }
+
+    private:
+        const char* data;
+        size_t len;
+        size_t offset;
+        ssize_t result;
+    };
+
+    // Accepts a connection on a listening fd. Yields the new non-blocking
+    // fd, or -1 on error.
+    class AcceptOp : public Operation {
+    public:
+        explicit AcceptOp(AsyncFd& owner) : Operation(owner, POLLER_READ), result(-1) {}
+        int await_resume() const { return result; }
+
+    protected:
+        bool attempt() override {
+            while (true) {
+                int client = accept4(owner.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (client < 0 && (errno == EINTR || errno == ECONNABORTED)) continue;
+                if (client < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+                result = client;
+                return true;
+            }
+        }
+        void fail() override { result = -1; }
+
+    private:
+        int result;
+    };
+
+    ReadOp read(std::string& in, size_t budget) { return ReadOp(*this, in, budget); }
+    WriteOp write(const char* data, size_t len) { return WriteOp(*this, data, len); }
+    AcceptOp accept() { return AcceptOp(*this); }
+
+private:
+    AsyncFd(const AsyncFd&);
+    AsyncFd& operator=(const AsyncFd&);
+
+    // Watches the fd for what op needs; only a change of interest, or input
+    // left unread, costs a call
+    bool wait(Operation* op) {
+        int events = op->events | POLLER_EDGE;
+        int ret = 0;
+        if (!interest) ret = addFdToReactor(reactor, fd, events, onEvent, this);
+        else if (interest != events || rearm) ret = modifyFdInReactor(reactor, fd, events);
+        if (ret < 0) return false;
+        interest = events;
+        rearm = false;
+        pending = op;
+        return true;
+    }
+
+    static void onEvent(int /*fd*/, int events, void* context) {
+        AsyncFd* self = static_cast<AsyncFd*>(context);
+        Operation* op = self->pending;
+        if (!op || !(events & (op->events | POLLER_ERROR)) || !op->attempt()) return;
+        self->pending = nullptr;
+        // The coroutine may finish and destroy this object; nothing after
+        op->waiter.resume();
+    }
+
+    void* reactor;
+    int fd;
+    int interest;          // POLLER_* interest registered, 0 if not registered
+    bool drained;          // the next read waits for the reactor
+    bool rearm;            // the last read left input, which must be reported again
+    Operation* pending;    // awaited operation, in the suspended coroutine's frame
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // COROUTINE_HPP
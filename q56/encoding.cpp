@@ -0,0 +1,106 @@
+#include "encoding.hpp"
+#include "binary.hpp"
+#include <algorithm>
+#include <cstdint>
+
+bool parseSccFormat(const std::string& name, SccFormat& format) {
+    if (name.empty() || name == "text") format = FORMAT_TEXT;
+    else if (name == "labels") format = FORMAT_LABELS;
+    else if (name == "varint") format = FORMAT_VARINT;
+    else if (name == "ranges") format = FORMAT_RANGES;
+    else if (name == "compact") format = FORMAT_COMPACT;
+    else return false;
+    return true;
+}
+
+static const char* formatName(SccFormat format) {
+    switch (format) {
+        case FORMAT_LABELS: return "labels";
+        case FORMAT_VARINT: return "varint";
+        case FORMAT_RANGES: return "ranges";
+        default: return "text";
+    }
+}
+
+static void putVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+static void encodeLabels(const std::vector<std::vector<int>>& sccs, int n, std::string& out) {
+    size_t base = out.size();
+    out.resize(base + 4 * (size_t)n);
+    char* labels = &out[base];
+    for (size_t i = 0; i < sccs.size(); ++i) {
+        for (int v : sccs[i]) {
+            if (v >= 1 && v <= n) putU32(labels + 4 * (size_t)(v - 1), (uint32_t)i);
+        }
+    }
+}
+
+static void encodeVarint(const std::vector<std::vector<int>>& sorted, std::string& out) {
+    for (const auto& members : sorted) {
+        putVarint(out, (uint32_t)members.size());
+        int previous = 0;
+        for (int v : members) {
+            putVarint(out, (uint32_t)(v - previous));
+            previous = v;
+        }
+    }
+}
+
+static void encodeRanges(const std::vector<std::vector<int>>& sorted, std::string& out) {
+    for (const auto& members : sorted) {
+        size_t runs = 0;
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (i == 0 || members[i] != members[i - 1] + 1) ++runs;
+        }
+        putVarint(out, (uint32_t)runs);
+        int previousEnd = 0;
+        size_t i = 0;
+        while (i < members.size()) {
+            size_t j = i + 1;
+            while (j < members.size() && members[j] == members[j - 1] + 1) ++j;
+            putVarint(out, (uint32_t)(members[i] - previousEnd));
+            putVarint(out, (uint32_t)(j - i));
+            previousEnd = members[j - 1];
+            i = j;
+        }
+    }
+}
+
+// Ranges pay two numbers per run and varint one per member, so ranges win
+// once runs average more than two members
+static SccFormat chooseCompact(const std::vector<std::vector<int>>& sorted) {
+    size_t members = 0, runs = 0;
+    for (const auto& component : sorted) {
+        members += component.size();
+        for (size_t i = 0; i < component.size(); ++i) {
+            if (i == 0 || component[i] != component[i - 1] + 1) ++runs;
+        }
+    }
+    return 2 * runs < members ? FORMAT_RANGES : FORMAT_VARINT;
+}
+
+std::string encodeSccs(const std::vector<std::vector<int>>& sccs, int n, SccFormat format, const std::string& tag) {
+    std::string payload;
+    if (format == FORMAT_LABELS) {
+        encodeLabels(sccs, n, payload);
+    } else {
+        std::vector<std::vector<int>> sorted(sccs);
+        for (auto& members : sorted) std::sort(members.begin(), members.end());
+        if (format == FORMAT_COMPACT) format = chooseCompact(sorted);
+        if (format == FORMAT_RANGES) encodeRanges(sorted, payload);
+        else encodeVarint(sorted, payload);
+    }
+
+    std::string reply = "scc ";
+    reply += formatName(format);
+    reply += " " + std::to_string(sccs.size()) + " " + std::to_string(payload.size()) + " " + tag + "\n";
+    reply.reserve(reply.size() + payload.size());
+    reply += payload;
+    return reply;
+}
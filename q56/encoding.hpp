@@ -0,0 +1,38 @@
+#ifndef ENCODING_HPP
+#define ENCODING_HPP
+
+// Compact encodings of a Kosaraju answer, asked for with "Kosaraju <format>".
+// The reply is a header line "scc <format> <components> <bytes> <tag>"
+// followed by that many bytes:
+//
+//   labels   the component of each vertex 1..n as a little-endian uint32
+//   varint   per component: member count, then its members in increasing
+//            order, the first as is and the others as the gap to the
+//            previous one
+//   ranges   per component: run count, then per run of consecutive members
+//            the gap from the previous run's end (from 0 for the first) and
+//            the run length
+//
+// Every number but the labels is an unsigned LEB128 varint. "compact" picks
+// varint or ranges, whichever the answer suits, and names the choice in the
+// header. Components are numbered and listed in the order of the text reply.
+
+#include <string>
+#include <vector>
+
+enum SccFormat {
+    FORMAT_TEXT,
+    FORMAT_LABELS,
+    FORMAT_VARINT,
+    FORMAT_RANGES,
+    FORMAT_COMPACT,
+};
+
+// Maps a format name to its value; false if there is no such format
+bool parseSccFormat(const std::string& name, SccFormat& format);
+
+// Header and payload of the answer in one of the binary formats; tag names
+// the graph it was computed on
+std::string encodeSccs(const std::vector<std::vector<int>>& sccs, int n, SccFormat format, const std::string& tag);
+
+#endif // ENCODING_HPP
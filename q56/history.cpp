@@ -0,0 +1,38 @@
+#include "history.hpp"
+#include <algorithm>
+
+// splitmix64 finalizer; summing it over the members hashes the set
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+std::vector<uint64_t> ComponentHistory::record(uint64_t version, int n, const std::vector<std::vector<int>>& sccs) {
+    if (n != vertices) {
+        components.clear();
+        vertices = n;
+        baseVersion = version;
+    }
+
+    std::unordered_map<int, Entry> next;
+    next.reserve(sccs.size());
+    std::vector<uint64_t> since(sccs.size());
+    for (size_t i = 0; i < sccs.size(); ++i) {
+        const std::vector<int>& members = sccs[i];
+        if (members.empty()) continue;
+        uint64_t hash = 0;
+        int smallest = members[0];
+        for (int v : members) {
+            hash += mix((uint64_t)v);
+            smallest = std::min(smallest, v);
+        }
+        auto it = components.find(smallest);
+        bool same = it != components.end() && it->second.hash == hash && it->second.size == members.size();
+        since[i] = same ? it->second.since : version;
+        next.emplace(smallest, Entry{hash, members.size(), since[i]});
+    }
+    components.swap(next);
+    return since;
+}
@@ -0,0 +1,37 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Versions of the components in recent Kosaraju answers. A component keeps
+// the graph version it was first seen at for as long as its members stay
+// the same, so a client that holds the partition of version X only needs
+// the components newer than X: every vertex of a component that merged or
+// split is in one of those. Not thread-safe; the server records under
+// edgesMutex, which also keeps versions in order.
+class ComponentHistory {
+public:
+    // Records the partition of n vertices computed at graph version and
+    // returns, per component, the version it has existed unchanged since
+    std::vector<uint64_t> record(uint64_t version, int n, const std::vector<std::vector<int>>& sccs);
+
+    // Oldest version a delta can start from; the vertex count changed then,
+    // so a partition from before it needs replacing whole
+    uint64_t base() const { return baseVersion; }
+
+private:
+    struct Entry {
+        uint64_t hash;    // of the member set, independent of member order
+        size_t size;
+        uint64_t since;
+    };
+
+    std::unordered_map<int, Entry> components;  // by smallest member
+    int vertices = -1;
+    uint64_t baseVersion = 0;
+};
+
+#endif // HISTORY_HPP
@@ -0,0 +1,82 @@
+#include "labels.hpp"
+#include <cstring>
+
+// Labels a buffer gets room for at first; it doubles from there
+static const size_t MIN_LABELS = 1024;
+
+LabelPublisher::LabelPublisher() : fd(-1), base(nullptr), mapped(0), capacity{0, 0}, preparing(-1) {}
+
+LabelPublisher::~LabelPublisher() {
+    if (base) munmap(base, mapped);
+    if (fd >= 0) close(fd);
+}
+
+bool LabelPublisher::open(const char* name, uint32_t instance) {
+    // A previous server's object is left to the readers that still map it;
+    // they keep its last labels until they open the name again
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 || !grow(LABELS_HEADER_BYTES)) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return false;
+    }
+    header()->instance = instance;
+    header()->magic.store(LABELS_MAGIC, std::memory_order_release);
+    return true;
+}
+
+bool LabelPublisher::enabled() const {
+    return base != nullptr;
+}
+
+// Extends the object to bytes and maps all of it
+bool LabelPublisher::grow(size_t bytes) {
+    if (ftruncate(fd, bytes) < 0) return false;
+    void* view = base ? mremap(base, mapped, bytes, MREMAP_MAYMOVE)
+                      : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) return false;
+    base = static_cast<char*>(view);
+    mapped = bytes;
+    return true;
+}
+
+std::atomic<uint32_t>* LabelPublisher::prepare(uint32_t n) {
+    int idle = 1 - (int)(header()->live.load(std::memory_order_relaxed) & 1);
+    // Odd from before the first label is touched until publish()
+    std::atomic<uint64_t>& sequence = header()->buffers[idle].sequence;
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (n > capacity[idle]) {
+        // The old room stays behind: readers may be on it until the sequence
+        // tells them otherwise
+        size_t labels = capacity[idle] ? 2 * capacity[idle] : MIN_LABELS;
+        while (labels < n) labels *= 2;
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t offset = (mapped + page - 1) / page * page;
+        // The mapping may move, and the header with it
+        if (!grow(offset + 4 * labels)) {
+            // Untouched after all; even again
+            std::atomic<uint64_t>& moved = header()->buffers[idle].sequence;
+            moved.store(moved.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            preparing = -1;
+            return nullptr;
+        }
+        header()->buffers[idle].offset.store(offset, std::memory_order_relaxed);
+        capacity[idle] = labels;
+    }
+    preparing = idle;
+    return reinterpret_cast<std::atomic<uint32_t>*>(base + header()->buffers[idle].offset.load(std::memory_order_relaxed));
+}
+
+void LabelPublisher::publish(uint64_t graphVersion, uint32_t n, uint32_t components) {
+    if (preparing < 0) return;
+    LabelBuffer& b = header()->buffers[preparing];
+    b.graphVersion.store(graphVersion, std::memory_order_relaxed);
+    b.vertices.store(n, std::memory_order_relaxed);
+    b.components.store(components, std::memory_order_relaxed);
+    b.sequence.store(b.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header()->live.store(preparing, std::memory_order_release);
+    preparing = -1;
+}
@@ -0,0 +1,162 @@
+#ifndef LABELS_HPP
+#define LABELS_HPP
+
+// Component labels the server publishes for other processes on this host
+// (server -L <name>). The POSIX shared-memory object <name> holds the
+// component of every vertex of the current graph, numbered like the binary
+// OP_KOSARAJU reply, so a reader maps it and answers "which component is v
+// in?" with a few loads: no request, no system call, no lock.
+//
+// The object holds a header and two label buffers. The server fills the
+// buffer readers are not on and then makes it the live one, so a lookup
+// normally reads a buffer nobody writes. Each buffer has a sequence count
+// that is odd while the server rewrites it; a reader that sees the count
+// change under it, which takes two publications during one lookup, retries.
+// A buffer that must grow moves to the end of the object, which only ever
+// grows; a reader maps the larger object when a buffer points past its view.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// First word of the object once the server has set it up
+const uint32_t LABELS_MAGIC = 0x5343434c;
+
+// Bytes before the first label buffer
+const size_t LABELS_HEADER_BYTES = 4096;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "label headers must be lock-free to be shared");
+
+// One published partition, on a cache line of its own
+struct alignas(64) LabelBuffer {
+    std::atomic<uint64_t> sequence;      // odd while the server rewrites this buffer
+    std::atomic<uint64_t> graphVersion;  // graph the labels were computed on
+    std::atomic<uint64_t> offset;        // where its labels start in the object
+    std::atomic<uint32_t> vertices;
+    std::atomic<uint32_t> components;
+};
+
+struct LabelHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t instance;               // with graphVersion, the tag Kosaraju replies carry
+    std::atomic<uint32_t> live;      // the buffer readers use
+    LabelBuffer buffers[2];
+};
+
+// A reader's view of the published labels. Not thread-safe; give each
+// thread its own.
+class LabelReader {
+public:
+    LabelReader() : fd(-1), base(nullptr), mapped(0) {}
+    ~LabelReader() { close(); }
+
+    // Maps the object the server publishes as name. False if there is none
+    // yet or the server has not set it up.
+    bool open(const char* name) {
+        close();
+        fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0 || !remap(LABELS_HEADER_BYTES)) {
+            close();
+            return false;
+        }
+        if (header()->magic.load(std::memory_order_acquire) != LABELS_MAGIC) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(base, mapped);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        base = nullptr;
+        mapped = 0;
+    }
+
+    // Component of vertex v (1..vertices) and the graph version it belongs
+    // to. False, with the version still set, if v is not a vertex of that
+    // graph or the object cannot be mapped.
+    bool lookup(uint32_t v, uint32_t& component, uint64_t& version) {
+        while (true) {
+            uint32_t live = header()->live.load(std::memory_order_acquire) & 1;
+            const LabelBuffer& b = header()->buffers[live];
+            uint64_t before = b.sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            version = b.graphVersion.load(std::memory_order_relaxed);
+            uint32_t vertices = b.vertices.load(std::memory_order_relaxed);
+            uint64_t offset = b.offset.load(std::memory_order_relaxed);
+            bool found = v >= 1 && v <= vertices;
+            if (found && offset + 4 * (uint64_t)v > mapped) {
+                // Values read under a changing sequence may be garbage; only
+                // a consistent view is worth remapping for
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (b.sequence.load(std::memory_order_relaxed) != before) continue;
+                if (!remap(offset + 4 * (uint64_t)v)) return false;
+                continue;
+            }
+            if (found) {
+                const std::atomic<uint32_t>* labels = reinterpret_cast<const std::atomic<uint32_t>*>(base + offset);
+                component = labels[v - 1].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (b.sequence.load(std::memory_order_relaxed) == before) return found;
+        }
+    }
+
+private:
+    const LabelHeader* header() const { return reinterpret_cast<const LabelHeader*>(base); }
+
+    // Maps the whole object, which must hold at least need bytes
+    bool remap(uint64_t need) {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < need) return false;
+        void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (view == MAP_FAILED) return false;
+        if (base) munmap(base, mapped);
+        base = static_cast<char*>(view);
+        mapped = st.st_size;
+        return true;
+    }
+
+    int fd;
+    char* base;
+    size_t mapped;
+};
+
+// The server's side: keeps the object up to date. One thread publishes;
+// prepare() and publish() alternate.
+class LabelPublisher {
+public:
+    LabelPublisher();
+    ~LabelPublisher();
+
+    // Creates, or takes over, the object name; instance goes into its header
+    bool open(const char* name, uint32_t instance);
+
+    // Whether open() succeeded
+    bool enabled() const;
+
+    // Labels of the buffer readers are not on, with room for n of them, to
+    // be filled in and then published; nullptr if the object cannot grow
+    std::atomic<uint32_t>* prepare(uint32_t n);
+
+    // Makes the prepared labels the live ones
+    void publish(uint64_t graphVersion, uint32_t n, uint32_t components);
+
+private:
+    LabelHeader* header() const { return reinterpret_cast<LabelHeader*>(base); }
+    bool grow(size_t bytes);
+
+    int fd;
+    char* base;
+    size_t mapped;          // bytes of the object, all of them mapped
+    size_t capacity[2];     // labels each buffer has room for
+    int preparing;          // buffer handed out by prepare(), -1 if none
+};
+
+#endif // LABELS_HPP
@@ -0,0 +1,622 @@
+// Load generator for the SCC server. Each client thread keeps a batch of
+// pipelined Kosaraju requests (one unless -P says more) in flight and times
+// the round trip; -B makes them use the binary protocol and -f asks for a
+// compact reply format. With -u it measures every run over TCP loopback and
+// again over the server's Unix domain socket, and -m adds a run over shared
+// memory rings negotiated on that socket (see shm.hpp), speaking binary
+// frames. -L names the server's label object (see labels.hpp), and a last run
+// looks components up in it directly. -W checks the server's write deadline
+// after its loop has slept for that many seconds. Given the server binary with -s,
+// it starts the server once per backend and compares them on the same workload,
+// including the server's own CPU time per request.
+//
+//   loadgen [-c clients] [-d seconds] [-n vertices] [-p port] [-s server] [-b backends] [-l loops] [-P depth] [-B] [-f format] [-u path] [-m] [-L name] [-W seconds]
+//
+// Build: g++ -std=c++17 -O2 -pthread loadgen.cpp -o loadgen
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "binary.hpp"
+#include "labels.hpp"
+#include "shm.hpp"
+
+// How a run reaches the server
+enum Transport {
+    TRANSPORT_TCP,
+    TRANSPORT_UNIX,
+    TRANSPORT_SHM,   // rings set up over the Unix domain socket
+};
+
+struct Options {
+    int clients = 16;
+    int seconds = 5;
+    int vertices = 100;
+    int port = 9034;
+    const char* server = nullptr;
+    std::string backends = "select,poll,epoll,uring";
+    const char* loops = "1";   // server event loops (-t)
+    int depth = 1;             // requests each client sends before reading replies
+    bool binary = false;       // speak the binary protocol instead of text
+    std::string format;        // reply format for Kosaraju, text if empty
+    const char* unixPath = nullptr;   // server's Unix domain socket (-u)
+    bool shm = false;          // add a run over shared memory (-m)
+    const char* labelsName = nullptr;   // server's label object (-L)
+    int idleSeconds = 0;       // silence before the write deadline check (-W)
+    Transport transport = TRANSPORT_TCP;   // this run's
+};
+
+struct Result {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    std::vector<uint32_t> latencyUs;
+};
+
+static int connectUnix(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// receiveBuffer, if non-zero, caps the TCP window; it must be set before connecting
+static int connectServer(const Options& opt, int receiveBuffer = 0) {
+    if (opt.transport != TRANSPORT_TCP) return connectUnix(opt.unixPath);
+    int port = opt.port;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (receiveBuffer) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t sent = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        off += sent;
+    }
+    return true;
+}
+
+static bool readExactly(int fd, size_t len) {
+    char buffer[65536];
+    while (len > 0) {
+        ssize_t got = read(fd, buffer, std::min(len, sizeof(buffer)));
+        if (got <= 0) return false;
+        len -= got;
+    }
+    return true;
+}
+
+static const char BINARY_REPLY[] = "Binary mode\n";
+
+
+// The Kosaraju request as the client sends it
+static std::string kosarajuRequest(const Options& opt) {
+    if (opt.binary) return binaryFrame(OP_KOSARAJU, 0);
+    return opt.format.empty() ? "Kosaraju\n" : "Kosaraju " + opt.format + "\n";
+}
+
+// Switches a connection to the binary protocol if asked to
+static bool enterMode(const Options& opt, int fd) {
+    if (!opt.binary) return true;
+    return sendAll(fd, "Binary\n") && readExactly(fd, sizeof(BINARY_REPLY) - 1);
+}
+
+// Reads until the server has been quiet for quietMs; replies carry no length.
+// The first byte may take longer: a large graph keeps the server busy.
+static std::string readReply(int fd, int quietMs) {
+    std::string reply;
+    char buffer[65536];
+    struct pollfd p = {fd, POLLIN, 0};
+    while (poll(&p, 1, reply.empty() ? 10 * quietMs : quietMs) > 0) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got <= 0) break;
+        reply.append(buffer, got);
+    }
+    return reply;
+}
+
+// Loads a ring over all vertices and returns the size of the Kosaraju reply,
+// which every client then reads back exactly
+static size_t prepareGraph(const Options& opt) {
+    int fd = connectServer(opt);
+    if (fd < 0) return 0;
+    if (opt.binary) {
+        std::string graph = binaryFrame(OP_NEWGRAPH, 8 + 8 * (size_t)opt.vertices);
+        char* p = &graph[FRAME_HEADER_BYTES + 1];
+        putU32(p, opt.vertices);
+        putU32(p + 4, opt.vertices);
+        for (int v = 1; v <= opt.vertices; ++v) {
+            putU32(p + 8 * v, v);
+            putU32(p + 8 * v + 4, (v % opt.vertices) + 1);
+        }
+        enterMode(opt, fd);
+        sendAll(fd, graph);
+    } else {
+        std::ostringstream graph;
+        graph << "Newgraph " << opt.vertices << " " << opt.vertices;
+        for (int v = 1; v <= opt.vertices; ++v) graph << " " << v << " " << (v % opt.vertices) + 1;
+        graph << "\n";
+        sendAll(fd, graph.str());
+    }
+    readReply(fd, 200);
+    sendAll(fd, kosarajuRequest(opt));
+    size_t size = readReply(fd, 200).size();
+    close(fd);
+    return size;
+}
+
+// A client's end of a shared-memory session
+struct ShmClient {
+    char* base = nullptr;
+    size_t mappedBytes = 0;
+    ShmRing requests;   // written here
+    ShmRing replies;    // read here
+    int serverBell = -1;
+    int clientBell = -1;
+};
+
+// Asks for shared memory on a fresh connection and maps the rings it gets
+static bool openShm(int fd, size_t ringBytes, ShmClient& s) {
+    if (!sendAll(fd, "Shm " + std::to_string(ringBytes) + "\n")) return false;
+    char text[64];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = {text, sizeof(text) - 1};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t got = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    struct cmsghdr* cmsg = got > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) return false;
+    int fds[3];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    text[got] = '\0';
+    unsigned long long granted = 0;
+    if (sscanf(text, "Shm %llu", &granted) != 1) granted = 0;
+
+    s.mappedBytes = shmMappedBytes(granted);
+    void* base = granted ? mmap(nullptr, s.mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fds[0], 0)
+                         : MAP_FAILED;
+    close(fds[0]);
+    s.serverBell = fds[1];
+    s.clientBell = fds[2];
+    if (base == MAP_FAILED) return false;
+    s.base = static_cast<char*>(base);
+    shmRings(s.base, granted, s.requests, s.replies);
+    return true;
+}
+
+static void closeShm(ShmClient& s) {
+    if (s.base) munmap(s.base, s.mappedBytes);
+    if (s.serverBell >= 0) close(s.serverBell);
+    if (s.clientBell >= 0) close(s.clientBell);
+}
+
+// Sleeps until the server rings; false if it stays silent for a second
+static bool waitBell(int bell) {
+    struct pollfd p = {bell, POLLIN, 0};
+    uint64_t count;
+    return poll(&p, 1, 1000) > 0 && read(bell, &count, sizeof(count)) == sizeof(count);
+}
+
+// One batch through the rings: the requests go in place, then each reply is
+// checked where the server wrote it and released
+static bool shmRoundTrip(ShmClient& s, const std::string& request, int depth, size_t replySize) {
+    for (int i = 0; i < depth; ++i) {
+        char* frame;
+        while (!(frame = s.requests.reserve(request.size()))) {
+            if (s.requests.writerMaySleep(request.size()) && !waitBell(s.clientBell)) return false;
+        }
+        memcpy(frame, request.data(), request.size());
+        if (s.requests.publish(request.size())) ringBell(s.serverBell);
+    }
+    for (int i = 0; i < depth; ++i) {
+        const char* reply;
+        while (!(reply = s.replies.peek())) {
+            if (s.replies.corrupt()) return false;
+            if (s.replies.readerMaySleep() && !waitBell(s.clientBell)) return false;
+        }
+        bool ok = FRAME_HEADER_BYTES + getU32(reply) == replySize && (uint8_t)reply[FRAME_HEADER_BYTES] == OP_KOSARAJU;
+        if (s.replies.consume()) ringBell(s.serverBell);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static void runClient(const Options& opt, size_t replySize, std::atomic<bool>& stop, Result& result) {
+    int fd = connectServer(opt);
+    ShmClient shm;
+    bool ready = fd >= 0 && (opt.transport == TRANSPORT_SHM ? openShm(fd, 2 * replySize * opt.depth, shm) : enterMode(opt, fd));
+    if (!ready) {
+        closeShm(shm);
+        if (fd >= 0) close(fd);
+        result.errors++;
+        return;
+    }
+    std::string request = kosarajuRequest(opt);
+    std::string batch;
+    for (int i = 0; i < opt.depth; ++i) batch += request;
+    result.latencyUs.reserve(1 << 16);
+    while (!stop.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = opt.transport == TRANSPORT_SHM ? shmRoundTrip(shm, request, opt.depth, replySize)
+                                                 : sendAll(fd, batch) && readExactly(fd, replySize * opt.depth);
+        if (!ok) {
+            result.errors++;
+            break;
+        }
+        // Every request of the batch waited for the whole of it
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        result.latencyUs.insert(result.latencyUs.end(), opt.depth, (uint32_t)us);
+        result.requests += opt.depth;
+    }
+    closeShm(shm);
+    close(fd);
+}
+
+// Drives the server on opt.port and prints one line. server is the pid started
+// for this run, whose CPU time is reported once it exits, or -1
+static bool runLoad(const Options& opt, const char* label, pid_t server) {
+    size_t replySize = prepareGraph(opt);
+    if (replySize == 0) {
+        std::cerr << label << ": no reply from server" << std::endl;
+        if (server > 0) {
+            kill(server, SIGKILL);
+            waitpid(server, nullptr, 0);
+        }
+        return false;
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<Result> results(opt.clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opt.clients; ++i) {
+        threads.emplace_back(runClient, std::cref(opt), replySize, std::ref(stop), std::ref(results[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+    stop = true;
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Result total;
+    for (auto& r : results) {
+        total.requests += r.requests;
+        total.errors += r.errors;
+        total.latencyUs.insert(total.latencyUs.end(), r.latencyUs.begin(), r.latencyUs.end());
+    }
+    std::sort(total.latencyUs.begin(), total.latencyUs.end());
+    auto quantile = [&](double q) -> uint32_t {
+        if (total.latencyUs.empty()) return 0;
+        return total.latencyUs[std::min(total.latencyUs.size() - 1, (size_t)(q * total.latencyUs.size()))];
+    };
+
+    // The server's CPU time, taken when it exits, shows the per-request cost of
+    // its I/O path (syscalls included) independent of client scheduling
+    double cpuUsPerReq = -1, sysShare = -1;
+    if (server > 0) {
+        kill(server, SIGTERM);
+        int status;
+        struct rusage usage;
+        if (wait4(server, &status, 0, &usage) == server && total.requests > 0) {
+            double user = usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec;
+            double sys = usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+            cpuUsPerReq = (user + sys) / total.requests;
+            sysShare = user + sys > 0 ? sys / (user + sys) : 0;
+        }
+    }
+
+    printf("%-11s %10.0f req/s  p50 %6u us  p99 %6u us  errors %llu", label, total.requests / elapsed, quantile(0.5),
+           quantile(0.99), (unsigned long long)total.errors);
+    if (cpuUsPerReq >= 0) printf("  server cpu %6.2f us/req (%2.0f%% sys)", cpuUsPerReq, sysShare * 100);
+    printf("\n");
+    return true;
+}
+
+// Looks up random vertices in the server's label object for the run's
+// duration, each client thread with a reader of its own. The graph is a
+// ring, so every vertex must be in component 0.
+static bool runLookups(const Options& opt, const char* label) {
+    if (prepareGraph(opt) == 0) {
+        std::cerr << label << ": no reply from server" << std::endl;
+        return false;
+    }
+    // The server publishes the labels of the new graph shortly after loading it
+    LabelReader probe;
+    uint32_t component;
+    uint64_t version;
+    bool ready = false;
+    for (int i = 0; i < 250 && !ready; ++i) {
+        ready = probe.open(opt.labelsName) && probe.lookup(opt.vertices, component, version);
+        if (!ready) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    if (!ready) {
+        std::cerr << label << ": no labels in " << opt.labelsName << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<Result> results(opt.clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opt.clients; ++i) {
+        threads.emplace_back([&opt, &stop, &results, i]() {
+            Result& result = results[i];
+            LabelReader reader;
+            if (!reader.open(opt.labelsName)) {
+                result.errors++;
+                return;
+            }
+            uint64_t state = 0x9e3779b97f4a7c15ull * (i + 1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int j = 0; j < 1024; ++j) {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    uint32_t found = 0, v = (uint32_t)(state % opt.vertices) + 1;
+                    uint64_t at;
+                    if (!reader.lookup(v, found, at) || found != 0) result.errors++;
+                }
+                result.requests += 1024;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+    stop = true;
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Result total;
+    for (auto& r : results) {
+        total.requests += r.requests;
+        total.errors += r.errors;
+    }
+    printf("%-11s %10.0f lookups/s  errors %llu\n", label, total.requests / elapsed, (unsigned long long)total.errors);
+    return true;
+}
+
+// Vertices of the graph whose reply the deadline check leaves unread; the
+// reply, some 15 MB, is far more than the socket buffers hold
+static const int DEADLINE_VERTICES = 2000000;
+// How long the reply is left unread, well inside the server's 30 s deadline
+static const int DEADLINE_UNREAD_SECONDS = 3;
+
+// Keeps a connection silent for opt.idleSeconds, with nothing else for the
+// server to do, then asks for a reply too large to send at once and leaves it
+// unread for a while. The server's write deadline must count from that
+// request, not from before its loop went to sleep, so the reply arrives whole.
+static bool runDeadlineCheck(const Options& opt, const char* label) {
+    Options tcp = opt;
+    tcp.transport = TRANSPORT_TCP;
+    int fd = connectServer(tcp, 4096);
+    if (fd < 0) {
+        std::cerr << label << ": no connection" << std::endl;
+        return false;
+    }
+    sendAll(fd, "Newgraph " + std::to_string(DEADLINE_VERTICES) + " 0\n");
+    readReply(fd, 200);
+    std::this_thread::sleep_for(std::chrono::seconds(opt.idleSeconds));
+
+    // Every vertex is a component of its own: "v \n" each, after "scc:\n"
+    size_t expected = 5;
+    for (int v = 1; v <= DEADLINE_VERTICES; ++v) expected += std::to_string(v).size() + 2;
+    sendAll(fd, "Kosaraju\n");
+    std::this_thread::sleep_for(std::chrono::seconds(DEADLINE_UNREAD_SECONDS));
+    // Through the small window the reply trickles; only a close or a long
+    // stall ends the read early
+    struct timeval stall = {10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &stall, sizeof(stall));
+    size_t got = 0;
+    char buffer[65536];
+    ssize_t n;
+    while (got < expected && (n = read(fd, buffer, sizeof(buffer))) > 0) got += n;
+    close(fd);
+    bool ok = got == expected;
+    printf("%-11s write deadline after %d s idle: %s (%zu of %zu bytes)\n", label, opt.idleSeconds,
+           ok ? "ok" : "FAILED", got, expected);
+    return ok;
+}
+
+// Starts the server with one backend and waits until it accepts connections
+static pid_t startServer(const Options& opt, const std::string& backend) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        std::vector<const char*> args = {opt.server, "-b", backend.c_str(), "-t", opt.loops};
+        if (opt.unixPath) args.insert(args.end(), {"-u", opt.unixPath});
+        if (opt.labelsName) args.insert(args.end(), {"-L", opt.labelsName});
+        args.push_back(nullptr);
+        execv(opt.server, const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    for (int i = 0; i < 100 && pid > 0; ++i) {
+        int fd = connectServer(opt);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    return -1;
+}
+
+// Waits until nothing listens on the TCP port any more. An io_uring server
+// tears its ring down after it exits, and until then its SO_REUSEPORT
+// listener still takes a share of the next server's connections.
+static void waitForRelease(const Options& opt) {
+    Options tcp = opt;
+    tcp.transport = TRANSPORT_TCP;
+    for (int i = 0; i < 100; ++i) {
+        int fd = connectServer(tcp);
+        if (fd < 0) return;
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "c:d:n:p:s:b:l:P:Bf:u:mL:W:")) != -1) {
+        switch (c) {
+            case 'c': opt.clients = atoi(optarg); break;
+            case 'd': opt.seconds = atoi(optarg); break;
+            case 'n': opt.vertices = atoi(optarg); break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 's': opt.server = optarg; break;
+            case 'b': opt.backends = optarg; break;
+            case 'l': opt.loops = optarg; break;
+            case 'P': opt.depth = atoi(optarg); break;
+            case 'B': opt.binary = true; break;
+            case 'f': opt.format = optarg; break;
+            case 'u': opt.unixPath = optarg; break;
+            case 'm': opt.shm = true; break;
+            case 'L': opt.labelsName = optarg; break;
+            case 'W': opt.idleSeconds = atoi(optarg); break;
+            default:
+                std::cerr << "Usage: " << argv[0]
+                          << " [-c clients] [-d seconds] [-n vertices] [-p port] [-s server] [-b backend,...] [-l loops]"
+                          << " [-P depth] [-B] [-f format] [-u unix_path] [-m] [-L labels_name] [-W idle_seconds]" << std::endl;
+                return 1;
+        }
+    }
+    if (opt.shm && !opt.unixPath) {
+        std::cerr << "-m needs the Unix domain socket (-u) to set up shared memory on" << std::endl;
+        return 1;
+    }
+    if (opt.clients <= 0 || opt.seconds <= 0 || opt.vertices <= 0 || opt.depth <= 0) {
+        std::cerr << "clients, seconds, vertices and depth must be positive" << std::endl;
+        return 1;
+    }
+
+    printf("%d clients, %d s, ring of %d vertices", opt.clients, opt.seconds, opt.vertices);
+    if (opt.depth > 1) printf(", %d pipelined", opt.depth);
+    if (opt.binary) printf(", binary");
+    if (!opt.format.empty()) printf(", %s replies", opt.format.c_str());
+    if (opt.server) printf(", %s server loop(s)", opt.loops);
+    printf("\n");
+
+    // TCP first, then the Unix domain socket if there is one
+    std::vector<Transport> transports = {TRANSPORT_TCP};
+    if (opt.unixPath) transports.push_back(TRANSPORT_UNIX);
+    if (opt.shm) transports.push_back(TRANSPORT_SHM);
+    static const char* transportNames[] = {"tcp", "unix", "shm"};
+
+    // Without a server binary, measure whatever is listening
+    if (!opt.server) {
+        bool ok = true;
+        for (Transport transport : transports) {
+            Options run = opt;
+            run.transport = transport;
+            // Rings carry binary frames only
+            if (transport == TRANSPORT_SHM) run.binary = true;
+            ok = runLoad(run, opt.unixPath ? transportNames[transport] : "server", -1) && ok;
+        }
+        if (opt.labelsName) ok = runLookups(opt, "labels") && ok;
+        if (opt.idleSeconds > 0) ok = runDeadlineCheck(opt, "deadline") && ok;
+        return ok ? 0 : 1;
+    }
+
+    std::stringstream list(opt.backends);
+    std::string backend;
+    while (std::getline(list, backend, ',')) {
+        for (Transport transport : transports) {
+            // The io_uring proactor serves sockets only
+            if (transport == TRANSPORT_SHM && backend == "uring") continue;
+            // A fresh server per run keeps its CPU time to that run
+            Options run = opt;
+            run.transport = transport;
+            run.labelsName = nullptr;
+            if (transport == TRANSPORT_SHM) run.binary = true;
+            pid_t pid = startServer(run, backend);
+            if (pid < 0) {
+                std::cerr << backend << ": server did not start" << std::endl;
+                continue;
+            }
+            std::string label = opt.unixPath ? backend + "/" + transportNames[transport] : backend;
+            runLoad(run, label.c_str(), pid);
+            waitForRelease(run);
+        }
+    }
+
+    // Lookups never reach the loops, so one server of the first backend will do
+    if (opt.labelsName) {
+        std::string first = opt.backends.substr(0, opt.backends.find(','));
+        pid_t pid = startServer(opt, first);
+        if (pid < 0) {
+            std::cerr << first << ": server did not start" << std::endl;
+            return 0;
+        }
+        runLookups(opt, "labels");
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+        waitForRelease(opt);
+    }
+
+    // A server to itself per backend, so no other connection wakes its loop
+    if (opt.idleSeconds > 0) {
+        std::stringstream again(opt.backends);
+        while (std::getline(again, backend, ',')) {
+            pid_t pid = startServer(opt, backend);
+            if (pid < 0) {
+                std::cerr << backend << ": server did not start" << std::endl;
+                continue;
+            }
+            runDeadlineCheck(opt, backend.c_str());
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+            waitForRelease(opt);
+        }
+    }
+    return 0;
+}
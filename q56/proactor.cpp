@@ -0,0 +1,295 @@
+#include "proactor.hpp"
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Provided receive buffers shared by every connection
+static const unsigned short BUFFER_GROUP = 0;
+static const unsigned BUFFER_COUNT = 256;
+static const unsigned BUFFER_SIZE = 16384;
+
+// Constructor implementation
+Proactor::Proactor(unsigned entries)
+    : ring(entries), buffers(ring, BUFFER_GROUP, BUFFER_COUNT, BUFFER_SIZE), running(true) {}
+
+bool Proactor::ok() const {
+    return ring.ok() && buffers.ok();
+}
+
+// Accepts on fd until it is removed
+int Proactor::addListener(int fd, proactorAcceptFunc func) {
+    if (fd < 0) return -1;
+    listeners[fd] = func;
+    armAccept(fd);
+    return 0;
+}
+
+// Receives on a connected fd
+int Proactor::addConnection(int fd, proactorReadFunc func) {
+    if (fd < 0) return -1;
+    Conn& c = conns[fd];
+    c = Conn();
+    c.func = func;
+    armRecv(fd);
+    return 0;
+}
+
+// Queues data to be written to fd, in order
+int Proactor::send(int fd, std::string data) {
+    auto it = conns.find(fd);
+    if (it == conns.end() || it->second.closing) return -1;
+    if (data.empty()) return 0;
+    Conn& c = it->second;
+    c.out.push_back(Output{std::move(data), 0, false});
+    // A chain already in flight picks the rest up when it completes
+    if (c.chainLen == 0) submitSends(fd, c);
+    return 0;
+}
+
+// Shuts fd down; it is closed once its operations complete
+int Proactor::closeConnection(int fd) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) return -1;
+    Conn& c = it->second;
+    if (!c.closing) {
+        c.closing = true;
+        shutdown(fd, SHUT_RDWR);  // completes the pending receive
+    }
+    finishClose(fd, c);
+    return 0;
+}
+
+// Stops the loop after the current batch
+int Proactor::stop() {
+    running = false;
+    return 0;
+}
+
+void Proactor::armAccept(int fd) {
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;  // one SQE, a CQE per connection
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = tag(OP_ACCEPT, fd);
+}
+
+void Proactor::armRecv(int fd) {
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;  // keeps receiving until an error or EOF
+    sqe->flags = IOSQE_BUFFER_SELECT;     // the kernel picks a buffer when data arrives
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = tag(OP_RECV, fd);
+    conns[fd].recvArmed = true;
+}
+
+// Submits the head of the output queue as one chain of linked sends, so they
+// reach the socket in order without waiting for each other's completion
+void Proactor::submitSends(int fd, Conn& c) {
+    unsigned n = c.out.size() < MAX_CHAIN ? (unsigned)c.out.size() : MAX_CHAIN;
+    // A chain must not be split across submissions
+    if (ring.freeSqes() < n) ring.submit(0);
+    if (ring.freeSqes() < n) n = ring.freeSqes();
+    if (n == 0) {
+        // The kernel took nothing; the queue waits for the next submit
+        starved.push_back(fd);
+        return;
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        Output& o = c.out[i];
+        struct io_uring_sqe* sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(o.data.data() + o.offset);
+        sqe->len = (unsigned)(o.data.size() - o.offset);
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;  // a short send fails the link
+        if (i + 1 < n) sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = tag(OP_SEND, fd);
+    }
+    c.chainLen = n;
+    c.chainDone = 0;
+}
+
+void Proactor::onAccept(int fd, const struct io_uring_cqe& cqe) {
+    auto it = listeners.find(fd);
+    if (cqe.res >= 0) {
+        if (it != listeners.end()) it->second(fd, cqe.res);
+        else close(cqe.res);
+    } else if (cqe.res != -ECANCELED) {
+        std::cerr << "accept: " << strerror(-cqe.res) << std::endl;
+    }
+    // The multishot accept ended; start another
+    if (!(cqe.flags & IORING_CQE_F_MORE) && it != listeners.end()) armAccept(fd);
+}
+
+void Proactor::onRecv(int fd, const struct io_uring_cqe& cqe) {
+    auto it = conns.find(fd);
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        unsigned id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if (it != conns.end() && cqe.res > 0 && !it->second.closing) {
+            it->second.in.append(buffers.buffer(id), cqe.res);
+        }
+        buffers.recycle(id);
+    }
+    if (it == conns.end()) return;
+    Conn& c = it->second;
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (cqe.res > 0 || cqe.res == -ENOBUFS) {
+        // Out of buffers ends the multishot receive; ours are back, so rearm,
+        // unless the connection is closing and only waited for this receive
+        if (!more) {
+            c.recvArmed = false;
+            if (c.closing) {
+                finishClose(fd, c);
+                return;
+            }
+            armRecv(fd);
+        }
+    } else {
+        // EOF or error
+        c.recvArmed = false;
+        if (c.closing) {
+            finishClose(fd, c);
+            return;
+        }
+        c.eof = true;
+    }
+
+    if (!c.dirty && (!c.in.empty() || c.eof)) {
+        c.dirty = true;
+        dirty.push_back(fd);
+    }
+}
+
+void Proactor::onSend(int fd, const struct io_uring_cqe& cqe) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) return;
+    Conn& c = it->second;
+    Output& o = c.out[c.chainDone++];
+
+    if (cqe.res >= 0) {
+        // A short send cancels the rest of the chain; it is resubmitted from here
+        o.offset += cqe.res;
+        if (o.offset == o.data.size()) o.done = true;
+    } else if (cqe.res != -ECANCELED && !c.closing) {
+        // Write error: report the connection as gone
+        c.eof = true;
+        if (!c.dirty) {
+            c.dirty = true;
+            dirty.push_back(fd);
+        }
+    }
+    if (c.chainDone < c.chainLen) return;
+
+    // Whole chain completed: drop what was written, resubmit the rest
+    while (!c.out.empty() && c.out.front().done) c.out.pop_front();
+    c.chainLen = 0;
+    if (c.closing) finishClose(fd, c);
+    else if (!c.out.empty() && !c.eof) submitSends(fd, c);
+}
+
+// Hands a connection's batch of input, then its EOF, to the handler
+void Proactor::deliver(int fd) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) return;
+    it->second.dirty = false;
+    proactorReadFunc func = it->second.func;
+
+    if (!it->second.in.empty() && !it->second.closing) {
+        std::string in;
+        in.swap(it->second.in);
+        func(fd, in.data(), in.size());
+        it = conns.find(fd);  // the handler may have closed it
+        if (it == conns.end()) return;
+    }
+    if (it->second.eof) {
+        it->second.eof = false;
+        func(fd, nullptr, 0);
+        closeConnection(fd);
+    }
+}
+
+// Closes fd once nothing in the kernel still refers to it or its buffers
+void Proactor::finishClose(int fd, Conn& c) {
+    if (!c.closing || c.recvArmed || c.chainLen > 0 || c.dirty) return;
+    close(fd);
+    conns.erase(fd);
+}
+
+// Runs the proactor
+void Proactor::run() {
+    while (running) {
+        // Submit everything queued by the last batch and wait, one syscall
+        if (ring.submit(1) < 0) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        // Sends that found the queue full go in now that it has drained
+        if (!starved.empty()) {
+            std::vector<int> retry;
+            retry.swap(starved);
+            for (int fd : retry) {
+                auto it = conns.find(fd);
+                if (it == conns.end()) continue;
+                Conn& c = it->second;
+                if (!c.closing && !c.eof && c.chainLen == 0 && !c.out.empty()) submitSends(fd, c);
+            }
+        }
+
+        struct io_uring_cqe cqe;
+        while (ring.popCompletion(cqe)) {
+            int fd = (int)(uint32_t)cqe.user_data;
+            switch ((Op)(cqe.user_data >> 56)) {
+                case OP_ACCEPT: onAccept(fd, cqe); break;
+                case OP_RECV: onRecv(fd, cqe); break;
+                case OP_SEND: onSend(fd, cqe); break;
+                default: break;
+            }
+        }
+
+        // Input that arrived in several completions is handed over as one piece
+        for (size_t i = 0; i < dirty.size(); ++i) deliver(dirty[i]);
+        dirty.clear();
+    }
+}
+
+// Function implementations
+void* startProactor() {
+    Proactor* proactor = new Proactor();
+    if (!proactor->ok()) {
+        delete proactor;
+        return nullptr;
+    }
+    return proactor;
+}
+
+int addListenerToProactor(void* proactor, int fd, proactorAcceptFunc func) {
+    Proactor* p = static_cast<Proactor*>(proactor);
+    return p->addListener(fd, func);
+}
+
+int addFdToProactor(void* proactor, int fd, proactorReadFunc func) {
+    Proactor* p = static_cast<Proactor*>(proactor);
+    return p->addConnection(fd, func);
+}
+
+int sendToProactor(void* proactor, int fd, std::string data) {
+    Proactor* p = static_cast<Proactor*>(proactor);
+    return p->send(fd, std::move(data));
+}
+
+int closeFdInProactor(void* proactor, int fd) {
+    Proactor* p = static_cast<Proactor*>(proactor);
+    return p->closeConnection(fd);
+}
+
+int stopProactor(void* proactor) {
+    Proactor* p = static_cast<Proactor*>(proactor);
+    return p->stop();
+}
@@ -0,0 +1,99 @@
+#ifndef PROACTOR_HPP
+#define PROACTOR_HPP
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/uring.hpp"
+
+// Called with each connection a listener accepted
+typedef void (*proactorAcceptFunc)(int listenFd, int clientFd);
+
+// Called with the bytes received for fd in one batch of completions; len is 0
+// once the peer is gone, after which the proactor closes fd itself
+typedef void (*proactorReadFunc)(int fd, const char* data, size_t len);
+
+// Completion-based counterpart of the Reactor on io_uring. Instead of being told
+// that a socket is readable, handlers are given data the kernel already received:
+// accepts and receives are multishot, receives land in a shared pool of provided
+// buffers, and queued replies go out as linked sends, one submission per batch.
+class Proactor {
+public:
+    explicit Proactor(unsigned entries = 256);
+
+    // False if io_uring is unavailable
+    bool ok() const;
+
+    // Accepts on fd until it is removed
+    int addListener(int fd, proactorAcceptFunc func);
+
+    // Receives on a connected fd
+    int addConnection(int fd, proactorReadFunc func);
+
+    // Queues data to be written to fd, in order
+    int send(int fd, std::string data);
+
+    // Shuts fd down; it is closed once its operations complete
+    int closeConnection(int fd);
+
+    // Stops the loop after the current batch
+    int stop();
+
+    // Runs the proactor
+    void run();
+
+private:
+    // Operation kinds, kept in the top byte of user_data; 0 is buffer upkeep
+    enum Op { OP_ACCEPT = 1, OP_RECV, OP_SEND };
+
+    struct Output {
+        std::string data;
+        size_t offset;
+        bool done;
+    };
+
+    struct Conn {
+        proactorReadFunc func = nullptr;
+        bool recvArmed = false;
+        bool closing = false;
+        bool eof = false;          // peer closed; reported after the data before it
+        bool dirty = false;        // has input or eof to deliver at the end of the batch
+        std::string in;            // received this batch, not delivered yet
+        std::deque<Output> out;
+        unsigned chainLen = 0;     // sends of out[] currently linked in the kernel
+        unsigned chainDone = 0;    // completions seen for that chain
+    };
+
+    static const unsigned MAX_CHAIN = 16;
+
+    static uint64_t tag(Op op, int fd) { return ((uint64_t)op << 56) | (uint32_t)fd; }
+
+    void armAccept(int fd);
+    void armRecv(int fd);
+    void submitSends(int fd, Conn& c);
+    void onAccept(int fd, const struct io_uring_cqe& cqe);
+    void onRecv(int fd, const struct io_uring_cqe& cqe);
+    void onSend(int fd, const struct io_uring_cqe& cqe);
+    void deliver(int fd);
+    void finishClose(int fd, Conn& c);
+
+    Uring ring;
+    ProvidedBuffers buffers;
+    bool running;
+    std::unordered_map<int, proactorAcceptFunc> listeners;
+    std::unordered_map<int, Conn> conns;
+    std::vector<int> dirty;
+    std::vector<int> starved;   // connections with sends the queue had no room for
+};
+
+// Function prototypes
+void* startProactor();
+int addListenerToProactor(void* proactor, int fd, proactorAcceptFunc func);
+int addFdToProactor(void* proactor, int fd, proactorReadFunc func);
+int sendToProactor(void* proactor, int fd, std::string data);
+int closeFdInProactor(void* proactor, int fd);
+int stopProactor(void* proactor);
+
+#endif // PROACTOR_HPP
@@ -0,0 +1,102 @@
+#include "profile.hpp"
+#include "stats.hpp"
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+// Per-thread allocation counters fed by the global operator new below
+static thread_local uint64_t allocatedBytes = 0;
+static thread_local uint64_t allocationCount = 0;
+
+void* operator new(std::size_t size) {
+    allocatedBytes += size;
+    ++allocationCount;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+uint64_t threadAllocatedBytes() {
+    return allocatedBytes;
+}
+
+uint64_t threadAllocations() {
+    return allocationCount;
+}
+
+const char* queryPhaseName(QueryPhase phase) {
+    switch (phase) {
+        case QPHASE_BUILD: return "build";
+        case QPHASE_DFS1: return "dfs1";
+        case QPHASE_DFS2: return "dfs2";
+        default: return "format";
+    }
+}
+
+PhaseTimer::PhaseTimer(PhaseProfile& phase)
+    : phase(phase), startNs(nowNs()), startBytes(allocatedBytes), startAllocations(allocationCount) {}
+
+PhaseTimer::~PhaseTimer() {
+    phase.ns += nowNs() - startNs;
+    phase.bytes += allocatedBytes - startBytes;
+    phase.allocations += allocationCount - startAllocations;
+}
+
+ProfileObserver::ProfileObserver(QueryProfile& profile)
+    : profile(profile), startNs(0), startBytes(0), startAllocations(0) {}
+
+void ProfileObserver::phaseBegin(scc::Phase) {
+    startNs = nowNs();
+    startBytes = allocatedBytes;
+    startAllocations = allocationCount;
+}
+
+void ProfileObserver::phaseEnd(scc::Phase phase) {
+    PhaseProfile& ph = profile.phases[phase];
+    ph.ns += nowNs() - startNs;
+    ph.bytes += allocatedBytes - startBytes;
+    ph.allocations += allocationCount - startAllocations;
+}
+
+std::string QueryProfile::explain() const {
+    std::stringstream out;
+    out << "explain:\n";
+    out << "graph vertices " << vertices << " edges " << edges << " version " << graphVersion << "\n";
+    out << "components " << components << "\n";
+
+    uint64_t totalNs = 0, totalBytes = 0;
+    for (int p = 0; p < QPHASE_COUNT; ++p) {
+        const PhaseProfile& ph = phases[p];
+        out << queryPhaseName((QueryPhase)p)
+            << " us " << ph.ns / 1000
+            << " vertices " << ph.vertices
+            << " edges " << ph.edges
+            << " depth " << ph.maxDepth
+            << " bytes " << ph.bytes
+            << " allocs " << ph.allocations << "\n";
+        totalNs += ph.ns;
+        totalBytes += ph.bytes;
+    }
+    out << "total us " << totalNs / 1000 << " bytes " << totalBytes << "\n";
+    return out.str();
+}
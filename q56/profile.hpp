@@ -0,0 +1,84 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "../common/scc_engine.hpp"
+
+// Phases of a single Kosaraju query; the first three are reported by the engine
+enum QueryPhase {
+    QPHASE_BUILD = scc::PHASE_BUILD,  // building adj/revAdj from the edge list
+    QPHASE_DFS1 = scc::PHASE_DFS1,    // first DFS, finishing order
+    QPHASE_DFS2 = scc::PHASE_DFS2,    // second DFS on the transposed graph
+    QPHASE_FORMAT,                    // rendering the reply
+    QPHASE_COUNT
+};
+
+// What one phase cost
+struct PhaseProfile {
+    uint64_t ns = 0;           // wall time
+    uint64_t vertices = 0;     // vertices visited
+    uint64_t edges = 0;        // edges scanned
+    uint64_t maxDepth = 0;     // deepest DFS stack
+    uint64_t bytes = 0;        // bytes allocated by the query thread
+    uint64_t allocations = 0;  // number of allocations
+};
+
+// Breakdown of one Kosaraju query, returned by the Explain command
+struct QueryProfile {
+    int vertices = 0;
+    size_t edges = 0;
+    size_t components = 0;
+    uint64_t graphVersion = 0;
+    PhaseProfile phases[QPHASE_COUNT];
+
+    std::string explain() const;
+};
+
+// Measures wall time and allocations of one phase on the calling thread
+class PhaseTimer {
+public:
+    explicit PhaseTimer(PhaseProfile& phase);
+    ~PhaseTimer();
+
+private:
+    PhaseProfile& phase;
+    uint64_t startNs;
+    uint64_t startBytes;
+    uint64_t startAllocations;
+};
+
+// Engine observer that fills a QueryProfile phase by phase
+class ProfileObserver {
+public:
+    explicit ProfileObserver(QueryProfile& profile);
+
+    void phaseBegin(scc::Phase phase);
+    void phaseEnd(scc::Phase phase);
+
+    void vertex(scc::Phase phase, size_t depth) {
+        PhaseProfile& ph = profile.phases[phase];
+        ++ph.vertices;
+        if (depth > ph.maxDepth) ph.maxDepth = depth;
+    }
+
+    void edge(scc::Phase phase) {
+        ++profile.phases[phase].edges;
+    }
+
+private:
+    QueryProfile& profile;
+    uint64_t startNs;
+    uint64_t startBytes;
+    uint64_t startAllocations;
+};
+
+// Bytes and allocations made by the calling thread since it started
+uint64_t threadAllocatedBytes();
+uint64_t threadAllocations();
+
+// Name of a query phase
+const char* queryPhaseName(QueryPhase phase);
+
+#endif // PROFILE_HPP
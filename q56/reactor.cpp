@@ -1,77 +1,209 @@
 #include "reactor.hpp"
+#include <chrono>
 #include <iostream>
 #include <unistd.h>
 
+// Milliseconds on the monotonic clock, the timer wheel's time base
+static uint64_t monotonicMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // Constructor implementation
-Reactor::Reactor() : max_fd(-1), running(false) {
-    FD_ZERO(&read_fds);
+Reactor::Reactor(ReactorBackend backend)
+    : poller(createPoller(backend)), running(false), loopThread(std::thread::id()), hasPending(false),
+      timers(monotonicMs()), tickFunc(nullptr), tickTimer(0) {
+    if (wakeup.fd() >= 0) poller->add(wakeup.fd(), POLLER_READ);
+}
+
+Reactor::~Reactor() {
+    delete poller;
 }
 
-// Starts the reactor
+// Starts the reactor; the calling thread owns it from here on
 void* Reactor::start() {
     running = true;
+    loopThread = std::this_thread::get_id();
     return this;
 }
 
 // Adds fd to the reactor
 int Reactor::addFd(int fd, reactorFunc func) {
-    std::lock_guard<std::mutex> lock(mtx);
+    return add(fd, Handler{func, nullptr, nullptr, nullptr, POLLER_READ});
+}
+
+// Adds fd to the reactor with an explicit POLLER_* interest
+int Reactor::addFd(int fd, int events, reactorEventFunc func) {
+    return add(fd, Handler{nullptr, func, nullptr, nullptr, events});
+}
+
+// Adds fd with a context pointer handed back on every event
+int Reactor::addFd(int fd, int events, reactorContextFunc func, void* context) {
+    return add(fd, Handler{nullptr, nullptr, func, context, events});
+}
+
+int Reactor::add(int fd, const Handler& handler) {
     if (fd < 0) return -1;
-    FD_SET(fd, &read_fds);
-    fd_map[fd] = func;
-    if (fd > max_fd) max_fd = fd;
+    if (!onLoopThread()) {
+        queueChange(Change{fd, CHANGE_ADD, handler, handler.events});
+        return 0;
+    }
+    if ((size_t)fd >= handlers.size()) handlers.resize(fd + 1, Handler{nullptr, nullptr, nullptr, nullptr, 0});
+    Handler& slot = handlers[fd];
+    // Registering again swaps the handler in place
+    int ret = slot.active() ? poller->modify(fd, handler.events) : poller->add(fd, handler.events);
+    if (ret < 0) {
+        perror("reactor add");
+        return -1;
+    }
+    slot = handler;
     return 0;
 }
 
+// Changes the interest of a registered fd
+int Reactor::modifyFd(int fd, int events) {
+    if (!onLoopThread()) {
+        queueChange(Change{fd, CHANGE_MODIFY, Handler{nullptr, nullptr, nullptr, nullptr, 0}, events});
+        return 0;
+    }
+    if (fd < 0 || (size_t)fd >= handlers.size() || !handlers[fd].active()) return -1;
+    handlers[fd].events = events;
+    return poller->modify(fd, events);
+}
+
 // Removes fd from the reactor
 int Reactor::removeFd(int fd) {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (fd_map.find(fd) == fd_map.end()) return -1;
-    FD_CLR(fd, &read_fds);
-    fd_map.erase(fd);
-    if (fd == max_fd) {
-        max_fd = -1;
-        for (const auto& pair : fd_map) {
-            if (pair.first > max_fd) max_fd = pair.first;
-        }
+    if (!onLoopThread()) {
+        queueChange(Change{fd, CHANGE_REMOVE, Handler{nullptr, nullptr, nullptr, nullptr, 0}, 0});
+        return 0;
     }
+    if (fd < 0 || (size_t)fd >= handlers.size() || !handlers[fd].active()) return -1;
+    handlers[fd] = Handler{nullptr, nullptr, nullptr, nullptr, 0};
+    poller->remove(fd);
+    return 0;
+}
+
+// Has the loop thread run func(context) before its next wait
+int Reactor::runInLoop(reactorCallFunc func, void* context) {
+    if (!func) return -1;
+    Change change{-1, CHANGE_CALL, Handler{nullptr, nullptr, nullptr, nullptr, 0}, 0};
+    change.call = func;
+    change.context = context;
+    queueChange(change);
     return 0;
 }
 
-// Stops the reactor
+// Stops the reactor; a loop blocked in wait() returns at once
 int Reactor::stop() {
-    std::lock_guard<std::mutex> lock(mtx);
     running = false;
+    wakeup.signal();
     return 0;
 }
 
+const char* Reactor::backendName() const {
+    return poller->name();
+}
+
+// Calls func every intervalMs on the loop thread
+void Reactor::setTick(int intervalMs, reactorTickFunc func) {
+    if (tickTimer) timers.cancel(tickTimer);
+    tickFunc = func;
+    tickTimer = func ? addTimer(intervalMs, intervalMs, runTick, this) : 0;
+}
+
+void Reactor::runTick(void* reactor) {
+    static_cast<Reactor*>(reactor)->tickFunc();
+}
+
+// Runs func(context) on the loop thread after delayMs, then every intervalMs.
+// The delay counts from now: the wheel last advanced before the wait that
+// woke this handler, which may have lasted minutes.
+TimerId Reactor::addTimer(int delayMs, int intervalMs, timerFunc func, void* context) {
+    if (delayMs < 0 || intervalMs < 0) return 0;
+    return timers.schedule(monotonicMs(), delayMs, intervalMs, func, context);
+}
+
+// Cancels a timer; false if it already fired or was cancelled
+bool Reactor::cancelTimer(TimerId id) {
+    return timers.cancel(id);
+}
+
+// The handler table and poller belong to the thread that started the reactor;
+// one that was never started may be set up from anywhere
+bool Reactor::onLoopThread() const {
+    std::thread::id loop = loopThread.load();
+    return loop == std::thread::id() || loop == std::this_thread::get_id();
+}
+
+// Hands a change to the loop thread and wakes it to apply the change
+void Reactor::queueChange(const Change& change) {
+    std::lock_guard<std::mutex> lock(mtx);
+    pending.push_back(change);
+    // One signal covers every change queued before the loop gets to them
+    if (!hasPending.exchange(true)) wakeup.signal();
+}
+
+// Applies registration changes queued by other threads
+void Reactor::applyChanges() {
+    std::vector<Change> changes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        changes.swap(pending);
+        hasPending = false;
+    }
+    for (const Change& c : changes) {
+        if (c.type == CHANGE_ADD) add(c.fd, c.handler);
+        else if (c.type == CHANGE_MODIFY) modifyFd(c.fd, c.events);
+        else if (c.type == CHANGE_REMOVE) removeFd(c.fd);
+        else c.call(c.context);
+    }
+}
+
 // Runs the reactor
 void Reactor::run() {
+    loopThread = std::this_thread::get_id();
     while (running) {
-        fd_set temp_fds;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            temp_fds = read_fds;
-        }
-        int activity = select(max_fd + 1, &temp_fds, nullptr, nullptr, nullptr);
+        // The lock is only taken when another thread queued something
+        if (hasPending.load(std::memory_order_acquire)) applyChanges();
 
-        if (activity < 0) {
-            perror("select error");
+        // Timers due by now run first; the wait then lasts until the next one,
+        // or until an fd fires or another thread wakes us if there is none
+        timers.advance(monotonicMs());
+        if (!running) break;
+        int timeoutMs = timers.timeoutMs();
+
+        ready.clear();
+        if (poller->wait(ready, timeoutMs) < 0) {
+            perror("reactor wait");
             break;
         }
 
-        for (const auto& pair : fd_map) {
-            int fd = pair.first;
-            if (FD_ISSET(fd, &temp_fds)) {
-                pair.second(fd); // Call the reactor function
+        // Only the descriptors that fired are visited; each is one index into
+        // the table, no lookup, lock or allocation
+        for (const PollerEvent& ev : ready) {
+            if (ev.fd == wakeup.fd()) {
+                wakeup.drain();  // pending changes are applied at the top of the loop
+                continue;
             }
+            if ((size_t)ev.fd >= handlers.size()) continue;
+            // A copy, since the handler may add fds and grow the table
+            Handler handler = handlers[ev.fd];
+            // Call the reactor function; a free slot was removed by an earlier handler
+            if (handler.contextFunc) handler.contextFunc(ev.fd, ev.events, handler.context);
+            else if (handler.eventFunc) handler.eventFunc(ev.fd, ev.events);
+            else if (handler.func) handler.func(ev.fd);
         }
     }
+    loopThread = std::thread::id();
 }
 
 // Function implementations
 void* startReactor() {
-    Reactor* reactor = new Reactor();
+    return startReactor(BACKEND_EPOLL);
+}
+
+void* startReactor(ReactorBackend backend) {
+    Reactor* reactor = new Reactor(backend);
     return reactor->start();
 }
 
@@ -80,11 +212,41 @@ int addFdToReactor(void* reactor, int fd, reactorFunc func) {
     return r->addFd(fd, func);
 }
 
+int addFdToReactor(void* reactor, int fd, int events, reactorEventFunc func) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->addFd(fd, events, func);
+}
+
+int addFdToReactor(void* reactor, int fd, int events, reactorContextFunc func, void* context) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->addFd(fd, events, func, context);
+}
+
+int modifyFdInReactor(void* reactor, int fd, int events) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->modifyFd(fd, events);
+}
+
 int removeFdFromReactor(void* reactor, int fd) {
     Reactor* r = static_cast<Reactor*>(reactor);
     return r->removeFd(fd);
 }
 
+TimerId addTimerToReactor(void* reactor, int delayMs, int intervalMs, timerFunc func, void* context) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->addTimer(delayMs, intervalMs, func, context);
+}
+
+bool cancelTimerInReactor(void* reactor, TimerId id) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->cancelTimer(id);
+}
+
+int runInReactor(void* reactor, reactorCallFunc func, void* context) {
+    Reactor* r = static_cast<Reactor*>(reactor);
+    return r->runInLoop(func, context);
+}
+
 int stopReactor(void* reactor) {
     Reactor* r = static_cast<Reactor*>(reactor);
     return r->stop();
@@ -1,18 +1,35 @@
 #ifndef REACTOR_HPP
 #define REACTOR_HPP
 
-#include <map>
-#include <sys/select.h>
+#include <atomic>
 #include <mutex>
+#include <thread>
+#include <vector>
+#include "../common/poller.hpp"
+#include "timer.hpp"
 
 // typedef for the reactor function
 typedef void (*reactorFunc)(int fd);
 
+// Reactor function that is also told which POLLER_* events fired
+typedef void (*reactorEventFunc)(int fd, int events);
+
+// Reactor function that also gets back the context it was registered with
+typedef void (*reactorContextFunc)(int fd, int events, void* context);
+
+// Function another thread has the loop thread run
+typedef void (*reactorCallFunc)(void* context);
+
+// Periodic callback run on the loop thread
+typedef void (*reactorTickFunc)();
+
 // Reactor class definition
 class Reactor {
 public:
-    // Constructor
-    Reactor();
+    // Constructor, epoll unless another backend is asked for
+    explicit Reactor(ReactorBackend backend = BACKEND_EPOLL);
+
+    ~Reactor();
 
     // Starts the reactor
     void* start();
@@ -20,27 +37,97 @@ public:
     // Adds fd to the reactor
     int addFd(int fd, reactorFunc func);
 
+    // Adds fd to the reactor with an explicit POLLER_* interest
+    int addFd(int fd, int events, reactorEventFunc func);
+
+    // Adds fd with a context pointer handed back on every event. Adding an fd
+    // that is already registered replaces its handler and interest.
+    int addFd(int fd, int events, reactorContextFunc func, void* context);
+
+    // Changes the interest of a registered fd
+    int modifyFd(int fd, int events);
+
     // Removes fd from the reactor
     int removeFd(int fd);
 
+    // Has the loop thread run func(context) before its next wait; callable
+    // from any thread, in order with the fd changes it makes
+    int runInLoop(reactorCallFunc func, void* context);
+
     // Stops the reactor
     int stop();
 
     // Runs the reactor
     void run();
 
+    // Name of the I/O backend in use
+    const char* backendName() const;
+
+    // Calls func every intervalMs on the loop thread
+    void setTick(int intervalMs, reactorTickFunc func);
+
+    // Runs func(context) on the loop thread after delayMs, then every
+    // intervalMs if that is non-zero. Loop thread only, like cancelTimer.
+    TimerId addTimer(int delayMs, int intervalMs, timerFunc func, void* context);
+
+    // Cancels a timer; false if it already fired or was cancelled
+    bool cancelTimer(TimerId id);
+
 private:
-    fd_set read_fds;
-    int max_fd;
-    bool running;
-    std::map<int, reactorFunc> fd_map;
-    std::mutex mtx; // mutex for thread safety
+    // One slot per fd number; a slot with no function is free
+    struct Handler {
+        reactorFunc func;
+        reactorEventFunc eventFunc;
+        reactorContextFunc contextFunc;
+        void* context;
+        int events;
+
+        bool active() const { return func || eventFunc || contextFunc; }
+    };
+
+    enum ChangeType { CHANGE_ADD, CHANGE_MODIFY, CHANGE_REMOVE, CHANGE_CALL };
+
+    // A registration change made off the loop thread, applied before the next wait
+    struct Change {
+        int fd;
+        ChangeType type;
+        Handler handler;
+        int events;
+        reactorCallFunc call = nullptr;
+        void* context = nullptr;
+    };
+
+    int add(int fd, const Handler& handler);
+    bool onLoopThread() const;
+    void queueChange(const Change& change);
+    void applyChanges();
+    static void runTick(void* reactor);
+
+    Poller* poller;
+    std::atomic<bool> running;
+    std::atomic<std::thread::id> loopThread;
+    std::vector<Handler> handlers;   // indexed by fd, owned by the loop thread, no lock
+    std::vector<Change> pending;     // changes from other threads, under mtx
+    std::atomic<bool> hasPending;
+    Wakeup wakeup;                   // interrupts wait() for pending changes and stop()
+    std::vector<PollerEvent> ready;
+    std::mutex mtx; // only guards pending
+    TimerWheel timers;               // drives the wait timeout; loop thread only
+    reactorTickFunc tickFunc;
+    TimerId tickTimer;
 };
 
 // Function prototypes
 void* startReactor();
+void* startReactor(ReactorBackend backend);
 int addFdToReactor(void* reactor, int fd, reactorFunc func);
+int addFdToReactor(void* reactor, int fd, int events, reactorEventFunc func);
+int addFdToReactor(void* reactor, int fd, int events, reactorContextFunc func, void* context);
+int modifyFdInReactor(void* reactor, int fd, int events);
 int removeFdFromReactor(void* reactor, int fd);
+TimerId addTimerToReactor(void* reactor, int delayMs, int intervalMs, timerFunc func, void* context);
+bool cancelTimerInReactor(void* reactor, TimerId id);
+int runInReactor(void* reactor, reactorCallFunc func, void* context);
 int stopReactor(void* reactor);
 
 #endif // REACTOR_HPP
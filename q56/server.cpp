@@ -1,216 +1,1583 @@
 #include "reactor.hpp"
+#include "stats.hpp"
+#include "profile.hpp"
+#include "connection.hpp"
+#include "proactor.hpp"
+#include "balancer.hpp"
+#include "coroutine.hpp"
+#include "workers.hpp"
+#include "binary.hpp"
+#include "encoding.hpp"
+#include "history.hpp"
+#include "labels.hpp"
 #include <iostream>
 #include <vector>
-#include <list>
-#include <stack>
 #include <algorithm>
 #include <sstream>
 #include <cstring>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <thread>   // Include thread header
+#include <unordered_map>
+#include <memory>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <random>
+#include <climits>
 #include <mutex>    // Include mutex header
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
 
 // Global graph data
 int n = 0, m = 0;
 std::vector<std::pair<int, int>> edges;
 std::mutex edgesMutex;  // Mutex for protecting access to edges
 
-void dfs1(int v, const std::vector<std::list<int>>& adj, std::vector<bool>& visited, std::stack<int>& finishStack) {
-    visited[v] = true;
-    for (int u : adj[v]) {
-        if (!visited[u]) {
-            dfs1(u, adj, visited, finishStack);
+// Component versions for "Kosaraju since", guarded by edgesMutex
+ComponentHistory history;
+
+// Tells this server's graph versions apart from another run's, whose
+// counter started from 0 as well
+static const uint32_t instanceId = std::random_device()();
+
+// Tag of the answers computed on a graph version. Equal tags mean equal
+// answers; anything else about the tag is opaque to clients.
+static std::string graphTag(uint64_t version) {
+    char tag[32];
+    snprintf(tag, sizeof(tag), "%08x-%llu", instanceId, (unsigned long long)version);
+    return tag;
+}
+
+// Labels published for other processes with -L (see labels.hpp). The
+// publisher thread wakes when labelsStale is set and computes the labels of
+// whatever graph is current by then, so a burst of changes costs one pass.
+static LabelPublisher labelPublisher;
+static std::mutex labelsMutex;
+static std::condition_variable labelsWanted;
+static bool labelsStale = true;   // under labelsMutex
+
+// Records a change of the graph; called under edgesMutex
+static void graphChanged() {
+    serverStats.graphChanged(n, edges.size());
+    if (!labelPublisher.enabled()) return;
+    {
+        std::lock_guard<std::mutex> lock(labelsMutex);
+        labelsStale = true;
+    }
+    labelsWanted.notify_one();
+}
+
+// Profile of the most recent Kosaraju query
+QueryProfile lastProfile;
+std::mutex profileMutex;
+
+// Kosaraju's algorithm; fills profile with the cost of each phase
+std::vector<std::vector<int>> kosaraju(int n, const std::vector<std::pair<int, int>>& edges, QueryProfile& profile) {
+    profile.vertices = n;
+    profile.edges = edges.size();
+
+    ProfileObserver observer(profile);
+    std::vector<std::vector<int>> sccs = scc::kosaraju<scc::CsrAdjacency>(n, edges, observer);
+
+    profile.phases[QPHASE_BUILD].vertices = n;
+    profile.phases[QPHASE_BUILD].edges = 2 * edges.size();
+    profile.components = sccs.size();
+    return sccs;
+}
+
+// Component sizes of a graph, gathered as the engine finds each component
+struct SccSummary {
+    size_t components = 0;
+    size_t largest = 0;
+    size_t bySize[64] = {};   // components with 2^i <= size < 2^(i+1)
+
+    std::string report() const {
+        std::stringstream out;
+        out << "sccstats:\n";
+        out << "components " << components << "\n";
+        out << "largest " << largest << "\n";
+        for (int i = 0; i < 64; ++i) {
+            if (!bySize[i]) continue;
+            out << "size " << ((size_t)1 << i);
+            if (i > 0) out << "-" << ((size_t)2 << i) - 1;
+            out << " count " << bySize[i] << "\n";
+        }
+        return out.str();
+    }
+};
+
+// Kosaraju's algorithm counting components and their sizes. Only the size
+// of the component being found is kept, never its members, so beyond the
+// graph itself the query needs the visited bits and the finishing order.
+SccSummary summarizeSccs(int n, const std::vector<std::pair<int, int>>& edges, QueryProfile& profile) {
+    profile.vertices = n;
+    profile.edges = edges.size();
+
+    SccSummary summary;
+    size_t size = 0;
+    ProfileObserver observer(profile);
+    scc::kosarajuVisit<scc::CsrAdjacency>(n, edges, observer,
+        [&size](int) { ++size; },
+        [&summary, &size]() {
+            ++summary.components;
+            summary.largest = std::max(summary.largest, size);
+            ++summary.bySize[63 - __builtin_clzll(size)];
+            size = 0;
+        });
+
+    profile.phases[QPHASE_BUILD].vertices = n;
+    profile.phases[QPHASE_BUILD].edges = 2 * edges.size();
+    profile.components = summary.components;
+    return summary;
+}
+
+// Renders the SCC reply, timing it as the format phase. Given the versions
+// record() returned, lists only the components newer than after.
+std::string formatSccs(const std::vector<std::vector<int>>& sccs, QueryProfile& profile, const std::string& header = "scc:\n",
+                       const std::vector<uint64_t>* since = nullptr, uint64_t after = 0) {
+    PhaseProfile& format = profile.phases[QPHASE_FORMAT];
+    PhaseTimer timer(format);
+    // Written straight into a pooled buffer sized up front, so a large reply
+    // is neither copied out of a stream nor grown step by step
+    size_t members = 0;
+    for (const auto& scc : sccs) members += scc.size();
+    std::string response = takeBuffer();
+    response.reserve(5 + members * 12 + sccs.size());
+    response += header;
+    char digits[16];
+    for (size_t i = 0; i < sccs.size(); ++i) {
+        if (since && (*since)[i] <= after) continue;
+        for (int v : sccs[i]) {
+            char* end = std::to_chars(digits, digits + sizeof(digits), v).ptr;
+            *end++ = ' ';
+            response.append(digits, end - digits);
         }
+        response += '\n';
     }
-    finishStack.push(v);
+    format.vertices = profile.vertices;
+    return response;
+}
+
+// Renders the SCC reply in a compact encoding, timing it as the format phase
+static std::string encodeSccs(const std::vector<std::vector<int>>& sccs, QueryProfile& profile, SccFormat format,
+                              const std::string& tag) {
+    PhaseProfile& phase = profile.phases[QPHASE_FORMAT];
+    PhaseTimer timer(phase);
+    phase.vertices = profile.vertices;
+    return encodeSccs(sccs, profile.vertices, format, tag);
 }
 
-void dfs2(int v, const std::vector<std::list<int>>& revAdj, std::vector<bool>& visited, std::vector<int>& component) {
-    visited[v] = true;
-    component.push_back(v);
-    for (int u : revAdj[v]) {
-        if (!visited[u]) {
-            dfs2(u, revAdj, visited, component);
+// Acquires edgesMutex and records how long the caller waited for it
+static void lockGraph(uint64_t* phaseNs) {
+    uint64_t start = nowNs();
+    edgesMutex.lock();
+    phaseNs[PHASE_LOCK_WAIT] += nowNs() - start;
+}
+
+// Swaps in a new graph, timing it as the compute phase
+static void replaceGraph(int newN, int newM, std::vector<std::pair<int, int>>& newEdges, uint64_t* phaseNs) {
+    lockGraph(phaseNs);  // Lock mutex before accessing shared data
+    uint64_t computeStart = nowNs();
+    n = newN;
+    m = newM;
+    edges.swap(newEdges);
+    graphChanged();
+    phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+    edgesMutex.unlock();  // Unlock mutex after accessing shared data
+}
+
+// Runs one request against the graph and returns the reply.
+// Fills cmd, error and the parse, lock-wait and compute entries of phaseNs.
+std::string processCommand(const std::string& request, Command& cmd, bool& error, uint64_t* phaseNs) {
+    uint64_t start = nowNs();
+    std::string command;
+    std::string response;
+    cmd = CMD_INVALID;
+    error = false;
+
+    std::stringstream ss(request);
+    ss >> command;
+
+    if (command == "Newgraph") {
+        cmd = CMD_NEWGRAPH;
+        int newN = 0, newM = 0;
+        ss >> newN >> newM;
+        if (newN < 0 || newM < 0) {
+            phaseNs[PHASE_PARSE] = nowNs() - start;
+            error = true;
+            return "Malformed graph\n";
+        }
+
+        // Read edges directly from command input
+        std::vector<std::pair<int, int>> newEdges;
+        for (int i = 0; i < newM; ++i) {
+            int u, v;
+            if (!(ss >> u >> v)) {
+                std::cerr << "Error reading edge " << i << std::endl;
+                error = true;
+                break;  // Exit loop on error
+            }
+            newEdges.push_back({u, v});
+        }
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        replaceGraph(newN, newM, newEdges, phaseNs);
+
+        response = "Graph updated\n";
+
+    } else if (command == "Kosaraju") {
+        // "Kosaraju <format>" asks for one of the encodings in encoding.hpp;
+        // "Kosaraju since <version>" for the components that changed after it;
+        // "Kosaraju ifnot <tag> [format]" for nothing if the tag is current.
+        // Every answer but the plain "scc:" one carries the tag of the graph
+        // it was computed on; a client that wants it asks with ifnot.
+        cmd = CMD_KOSARAJU;
+        std::string option, formatName, ifNotTag;
+        ss >> option;
+        bool delta = option == "since";
+        bool conditional = option == "ifnot";
+        uint64_t after = 0;
+        SccFormat format = FORMAT_TEXT;
+        if (delta) ss >> after;
+        else if (conditional) ss >> ifNotTag >> formatName;
+        else formatName = option;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+        if (delta && ss.fail()) {
+            error = true;
+            return "Invalid version\n";
+        }
+        if (conditional && ifNotTag.empty()) {
+            error = true;
+            return "Invalid tag\n";
+        }
+        if (!delta && !parseSccFormat(formatName, format)) {
+            error = true;
+            return "Invalid format\n";
+        }
+
+        lockGraph(phaseNs);  // Lock mutex before accessing shared data
+        uint64_t computeStart = nowNs();
+        QueryProfile profile;
+        profile.graphVersion = serverStats.graphVersion();
+        std::string tag = graphTag(profile.graphVersion);
+        if (conditional && ifNotTag == tag) {
+            // Same graph, same answer: nothing is computed or sent again
+            edgesMutex.unlock();
+            phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+            return "NotModified " + tag + "\n";
+        }
+        std::vector<std::vector<int>> sccs = kosaraju(n, edges, profile);
+        std::vector<uint64_t> since;
+        uint64_t base = 0;
+        if (delta) {
+            since = history.record(profile.graphVersion, n, sccs);
+            base = history.base();
+        }
+        edgesMutex.unlock();  // Unlock mutex after accessing shared data
+
+        std::string reply;
+        std::string version = std::to_string(profile.graphVersion);
+        if (!delta) {
+            // The plain reply keeps the header clients have always parsed
+            std::string header = conditional ? "scc tag " + tag + ":\n" : "scc:\n";
+            reply = format == FORMAT_TEXT ? formatSccs(sccs, profile, header) : encodeSccs(sccs, profile, format, tag);
+        } else if (after < base || after > profile.graphVersion) {
+            // Too old to patch, or not a version of this server: all of it
+            reply = formatSccs(sccs, profile, "scc version " + version + " tag " + tag + ":\n");
+        } else {
+            std::string header = "scc since " + std::to_string(after) + " version " + version + " tag " + tag + ":\n";
+            reply = formatSccs(sccs, profile, header, &since, after);
+        }
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        {
+            std::lock_guard<std::mutex> lock(profileMutex);
+            lastProfile = profile;
+        }
+        response = std::move(reply);
+
+    } else if (command == "Sccstats") {
+        // Sizes only: the reply stays a few lines however large the graph
+        cmd = CMD_SCCSTATS;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        lockGraph(phaseNs);
+        uint64_t computeStart = nowNs();
+        QueryProfile profile;
+        profile.graphVersion = serverStats.graphVersion();
+        SccSummary summary = summarizeSccs(n, edges, profile);
+        edgesMutex.unlock();
+
+        response = summary.report();
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        {
+            std::lock_guard<std::mutex> lock(profileMutex);
+            lastProfile = profile;
+        }
+
+    } else if (command == "Newedge") {
+        cmd = CMD_NEWEDGE;
+        int u, v;
+        ss >> u >> v;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        lockGraph(phaseNs);  // Lock mutex before accessing shared data
+        uint64_t computeStart = nowNs();
+        edges.emplace_back(u, v);
+        graphChanged();
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        edgesMutex.unlock();  // Unlock mutex after accessing shared data
+
+        response = "Edge added\n";
+
+    } else if (command == "Removeedge") {
+        cmd = CMD_REMOVEEDGE;
+        int u, v;
+        ss >> u >> v;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        lockGraph(phaseNs);  // Lock mutex before accessing shared data
+        uint64_t computeStart = nowNs();
+        auto it = std::find(edges.begin(), edges.end(), std::make_pair(u, v));
+        if (it != edges.end()) {
+            edges.erase(it);
+            graphChanged();
+            std::cout << "Edge " << u << " -> " << v << " removed" << std::endl; // Print statement after removing an edge
+        }
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        edgesMutex.unlock();  // Unlock mutex after accessing shared data
+
+        response = "Edge removed\n";
+
+    } else if (command == "Explain") {
+        // "Explain" describes the last query, "Explain run" profiles a fresh one
+        cmd = CMD_EXPLAIN;
+        std::string mode;
+        ss >> mode;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        QueryProfile profile;
+        if (mode == "run") {
+            lockGraph(phaseNs);
+            uint64_t computeStart = nowNs();
+            profile.graphVersion = serverStats.graphVersion();
+            std::vector<std::vector<int>> sccs = kosaraju(n, edges, profile);
+            edgesMutex.unlock();
+            formatSccs(sccs, profile);
+            phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        } else {
+            std::lock_guard<std::mutex> lock(profileMutex);
+            profile = lastProfile;
         }
+
+        response = profile.explain();
+
+    } else if (command == "Stats") {
+        cmd = CMD_STATS;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        uint64_t computeStart = nowNs();
+        std::string report = serverStats.report() + balancer.report() + workers.report();
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+
+        response = std::move(report);
+
+    } else if (command == "Binary") {
+        // The framer has already switched the connection to binary frames
+        cmd = CMD_BINARY;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+        response = "Binary mode\n";
+
+    } else if (command == "Shm") {
+        // Taken up by the connection when it can switch (see shm.hpp); here
+        // it came with other requests, or on a loop without shared memory
+        cmd = CMD_SHM;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+        error = true;
+        response = "Shm not available on this connection\n";
+
+    } else {
+        // Invalid command
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+        error = true;
+        response = "Invalid command\n";
     }
+
+    return response;
 }
 
-std::vector<std::vector<int>> kosaraju(int n, const std::vector<std::pair<int, int>>& edges) {
-    std::vector<std::list<int>> adj(n + 1), revAdj(n + 1);
-    for (const auto& edge : edges) {
-        adj[edge.first].push_back(edge.second);
-        revAdj[edge.second].push_back(edge.first);
+// Where processBinary builds its reply frame: a string for a socket, the
+// reply ring for a shared-memory client
+class FrameOutput {
+public:
+    virtual ~FrameOutput() {}
+
+    // Room for a whole frame of frameBytes, length prefix included, or
+    // nullptr if this output cannot take a frame that large
+    virtual char* reserve(size_t frameBytes) = 0;
+};
+
+class StringOutput : public FrameOutput {
+public:
+    char* reserve(size_t frameBytes) override {
+        frame.resize(frameBytes);
+        return &frame[0];
     }
 
-    std::stack<int> finishStack;
-    std::vector<bool> visited(n + 1, false);
-    
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1(i, adj, visited, finishStack);
+    std::string frame;
+};
+
+// Writes a frame carrying text; an OP_ERROR frame instead if out cannot take it
+static void putFrame(FrameOutput& out, BinaryOp op, const std::string& text) {
+    char* frame = out.reserve(FRAME_HEADER_BYTES + 1 + text.size());
+    if (!frame) {
+        putFrame(out, OP_ERROR, "Reply too large");
+        return;
+    }
+    putFrameHeader(frame, op, text.size());
+    memcpy(frame + FRAME_HEADER_BYTES + 1, text.data(), text.size());
+}
+
+// Kosaraju's algorithm replying with a binary OP_KOSARAJU frame. Each
+// vertex's component is written into the frame as the traversal finds it,
+// so no member lists are built and nothing is formatted. False, with
+// nothing computed, if out cannot take the frame.
+static bool kosarajuFrame(int n, const std::vector<std::pair<int, int>>& edges, QueryProfile& profile, FrameOutput& out) {
+    profile.vertices = n;
+    profile.edges = edges.size();
+
+    char* frame = out.reserve(FRAME_HEADER_BYTES + 9 + 4 * (size_t)n);
+    if (!frame) return false;
+    putFrameHeader(frame, OP_KOSARAJU, 8 + 4 * (size_t)n);
+    char* labels = frame + FRAME_HEADER_BYTES + 9;
+    uint32_t components = 0;
+    bool members = false;   // the component being found has a vertex in 1..n
+    ProfileObserver observer(profile);
+    // The engine follows edges to vertex 0 too; it has no label, and a
+    // component of nothing else is not counted
+    scc::kosarajuVisit<scc::CsrAdjacency>(n, edges, observer,
+        [labels, n, &components, &members](int v) {
+            if (v < 1 || v > n) return;
+            putU32(labels + 4 * (size_t)(v - 1), components);
+            members = true;
+        },
+        [&components, &members]() {
+            if (members) ++components;
+            members = false;
+        });
+
+    profile.phases[QPHASE_BUILD].vertices = n;
+    profile.phases[QPHASE_BUILD].edges = 2 * edges.size();
+    profile.components = components;
+    putU32(frame + FRAME_HEADER_BYTES + 1, (uint32_t)n);
+    putU32(frame + FRAME_HEADER_BYTES + 5, components);
+    return true;
+}
+
+// Runs one binary request (see binary.hpp), read in place, and builds the
+// reply frame in out. Fills cmd, error and phaseNs like processCommand.
+static void processBinary(const char* request, size_t requestBytes, Command& cmd, bool& error, uint64_t* phaseNs,
+                          FrameOutput& out) {
+    uint64_t start = nowNs();
+    cmd = CMD_INVALID;
+    error = false;
+    uint8_t op = requestBytes == 0 ? 0 : (uint8_t)request[0];
+    const char* body = request + 1;
+    size_t bodyBytes = requestBytes == 0 ? 0 : requestBytes - 1;
+
+    if (op == OP_NEWGRAPH) {
+        cmd = CMD_NEWGRAPH;
+        uint32_t newN = bodyBytes >= 8 ? getU32(body) : 0;
+        uint32_t newM = bodyBytes >= 8 ? getU32(body + 4) : 0;
+        if (bodyBytes < 8 || bodyBytes - 8 != 8 * (uint64_t)newM || newN > INT_MAX || newM > INT_MAX) {
+            phaseNs[PHASE_PARSE] = nowNs() - start;
+            error = true;
+            putFrame(out, OP_ERROR, "Malformed graph");
+            return;
         }
+        std::vector<std::pair<int, int>> newEdges(newM);
+        const char* p = body + 8;
+        for (uint32_t i = 0; i < newM; ++i, p += 8) {
+            newEdges[i].first = (int)getU32(p);
+            newEdges[i].second = (int)getU32(p + 4);
+        }
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        replaceGraph((int)newN, (int)newM, newEdges, phaseNs);
+        putFrame(out, OP_NEWGRAPH, std::string());
+        return;
+    }
+
+    if (op == OP_KOSARAJU) {
+        cmd = CMD_KOSARAJU;
+        phaseNs[PHASE_PARSE] = nowNs() - start;
+
+        lockGraph(phaseNs);
+        uint64_t computeStart = nowNs();
+        QueryProfile profile;
+        profile.graphVersion = serverStats.graphVersion();
+        bool fits = kosarajuFrame(n, edges, profile, out);
+        edgesMutex.unlock();
+        phaseNs[PHASE_COMPUTE] = nowNs() - computeStart;
+        if (!fits) {
+            error = true;
+            putFrame(out, OP_ERROR, "Reply too large");
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(profileMutex);
+            lastProfile = profile;
+        }
+        return;
+    }
+
+    if (op == OP_COMMAND) {
+        putFrame(out, OP_COMMAND, processCommand(std::string(body, bodyBytes), cmd, error, phaseNs));
+        return;
     }
 
-    std::fill(visited.begin(), visited.end(), false);
-    std::vector<std::vector<int>> sccs;
+    phaseNs[PHASE_PARSE] = nowNs() - start;
+    error = true;
+    putFrame(out, OP_ERROR, "Invalid opcode");
+}
 
-    while (!finishStack.empty()) {
-        int v = finishStack.top();
-        finishStack.pop();
+// Runs a request in whichever protocol it came
+static std::string processRequest(const Request& request, Command& cmd, bool& error, uint64_t* phaseNs) {
+    if (request.binary) {
+        StringOutput out;
+        processBinary(request.body.data(), request.body.size(), cmd, error, phaseNs, out);
+        return std::move(out.frame);
+    }
+    return processCommand(request.body, cmd, error, phaseNs);
+}
 
-        if (!visited[v]) {
-            std::vector<int> component;
-            dfs2(v, revAdj, visited, component);
-            sccs.push_back(component);
+// Publisher thread for -L: computes the labels of each graph version straight
+// into the buffer readers are not on, then makes it live
+static void publishLabels() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(labelsMutex);
+            labelsWanted.wait(lock, [] { return labelsStale; });
+            labelsStale = false;
+        }
+        uint64_t phaseNs[PHASE_COUNT] = {};
+        lockGraph(phaseNs);
+        uint64_t version = serverStats.graphVersion();
+        uint32_t vertices = (uint32_t)n;
+        std::atomic<uint32_t>* labels = labelPublisher.prepare(vertices);
+        uint32_t components = 0;
+        if (labels) {
+            // Numbered as kosarajuFrame numbers them: vertex 0 has no slot
+            bool members = false;
+            scc::NullObserver observer;
+            scc::kosarajuVisit<scc::CsrAdjacency>(n, edges, observer,
+                [labels, vertices, &components, &members](int v) {
+                    if (v < 1 || (uint32_t)v > vertices) return;
+                    labels[v - 1].store(components, std::memory_order_relaxed);
+                    members = true;
+                },
+                [&components, &members]() {
+                    if (members) ++components;
+                    members = false;
+                });
         }
+        edgesMutex.unlock();
+        if (labels) labelPublisher.publish(version, vertices, components);
+        else std::cerr << "Cannot grow the label object to " << vertices << " vertices" << std::endl;
     }
+}
 
-    return sccs;
+// Prints the address of a new client; local ones have no address to show
+static void printPeer(const struct sockaddr_storage& address) {
+    if (address.ss_family == AF_UNIX) {
+        std::cout << "New local connection" << std::endl;
+        return;
+    }
+    const struct sockaddr_in& in = reinterpret_cast<const struct sockaddr_in&>(address);
+    char clientAddr[INET_ADDRSTRLEN] = "?";
+    int port = 0;
+    if (address.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &in.sin_addr, clientAddr, INET_ADDRSTRLEN);
+        port = ntohs(in.sin_port);
+    }
+    std::cout << "New connection from " << clientAddr << ":" << port << std::endl;
 }
 
-void handleClient(int clientSocket) {
-    char buffer[1024] = {0};
+// Reactor of the calling event loop thread; it owns that thread's listener and connections
+thread_local void* reactor = nullptr;
+
+// This loop's client connections by fd; never shared between loops. Entries
+// stay put while they exist, so the reactor holds a pointer to each as context.
+thread_local std::unordered_map<int, Connection> connections;
+
+// Index of the calling event loop, for the balancer
+thread_local int loopIndex = 0;
+
+// Last id given to a connection of this loop
+thread_local uint64_t lastConnectionId = 0;
+
+// Whether loops hand connections to each other (more than one reactor loop)
+bool balancing = false;
+
+// Clients that send nothing for this long are disconnected; 0 never does (-i)
+int idleTimeoutMs = 300000;
+
+// Queued output that has not drained this long after backing up means the
+// client stopped reading; it is disconnected
+static const int WRITE_DEADLINE_MS = 30000;
+
+// Interest a connection needs given its buffers
+static int connectionEvents(const Connection& c) {
+    int events = POLLER_EDGE;
+    if (!c.readPaused) events |= POLLER_READ;
+    if (c.wantWrite) events |= POLLER_WRITE;
+    return events;
+}
+
+static void idleCheck(void* context);
+static void writeDeadline(void* context);
+
+// Starts the idle clock of a connection new to this loop
+static void watchConnection(Connection& c) {
+    c.lastInputNs = nowNs();
+    if (idleTimeoutMs > 0) c.idleTimer = addTimerToReactor(reactor, idleTimeoutMs, 0, idleCheck, &c);
+}
+
+// Cancels a connection's timers before it leaves this loop
+static void unwatchConnection(Connection& c) {
+    if (c.idleTimer) cancelTimerInReactor(reactor, c.idleTimer);
+    if (c.writeTimer) cancelTimerInReactor(reactor, c.writeTimer);
+    c.idleTimer = c.writeTimer = 0;
+}
+
+static void closeConnection(Connection& c) {
+    std::cout << "Client disconnected" << std::endl;
+    serverStats.connectionClosed();
+    unwatchConnection(c);
+    if (c.shm) {
+        removeFdFromReactor(reactor, c.shm->serverBell);
+        detachSharedMemory(c);
+    }
+    removeFdFromReactor(reactor, c.fd);
+    close(c.fd);
+    // Buffers still held for zero-copy sends are freed rather than pooled:
+    // the kernel keeps their pages pinned, and nothing reuses them meanwhile
+    connections.erase(c.fd);
+}
+
+// Writes what the socket takes, then updates write interest and backpressure.
+// Returns false if the connection was closed.
+static bool flushConnection(Connection& c) {
+    if (!c.held.empty()) reapZerocopy(c);
+    size_t written = 0;
+    bool ok = flushOutput(c, written);
+    if (written > 0) serverStats.bytesOut(written);
+    if (!ok) {
+        closeConnection(c);
+        return false;
+    }
+
+    bool wantWrite = !c.out.empty();
+    // The deadline runs from when output first backs up until it drains
+    if (wantWrite && !c.writeTimer) {
+        c.writeTimer = addTimerToReactor(reactor, WRITE_DEADLINE_MS, 0, writeDeadline, &c);
+    } else if (!wantWrite && c.writeTimer) {
+        cancelTimerInReactor(reactor, c.writeTimer);
+        c.writeTimer = 0;
+    }
+
+    bool readPaused = c.readPaused;
+    if (c.outBytes >= OUTPUT_HIGH_WATERMARK) readPaused = true;
+    else if (c.outBytes <= OUTPUT_LOW_WATERMARK) readPaused = false;
+
+    if (wantWrite != c.wantWrite || readPaused != c.readPaused) {
+        c.wantWrite = wantWrite;
+        c.readPaused = readPaused;
+        modifyFdInReactor(reactor, c.fd, connectionEvents(c));
+    }
+    return true;
+}
+
+// How one request went, recorded once its reply has been sent
+struct Outcome {
+    Command cmd;
+    bool error;
+    uint64_t phaseNs[PHASE_COUNT];
+};
+
+// Cuts every complete request out of in. False if the one being framed grew
+// past MAX_REQUEST_BYTES.
+static bool takeRequests(std::string& in, RequestFramer& framer, std::vector<Request>& requests) {
+    Request request;
+    while (nextRequest(in, framer, request)) requests.push_back(std::move(request));
+    return !framer.overflow;
+}
+
+// An error reply in the protocol the client speaks
+static std::string errorReply(bool binary, const char* message) {
+    return binary ? binaryFrame(OP_ERROR, std::string(message)) : std::string(message) + "\n";
+}
+
+// Runs pipelined requests in order and appends their replies to out, so a
+// batch of them goes back in one write
+static void runRequests(const std::vector<Request>& requests, std::string& out, std::vector<Outcome>& outcomes) {
+    outcomes.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        Outcome& o = outcomes[i];
+        memset(o.phaseNs, 0, sizeof(o.phaseNs));
+        std::string reply = processRequest(requests[i], o.cmd, o.error, o.phaseNs);
+        if (out.empty()) {
+            out = std::move(reply);
+        } else {
+            out += reply;
+            recycleBuffer(std::move(reply));
+        }
+    }
+}
+
+// Records a batch whose replies were sent together in sendNs
+static void recordOutcomes(std::vector<Outcome>& outcomes, uint64_t sendNs) {
+    for (Outcome& o : outcomes) {
+        o.phaseNs[PHASE_SEND] = sendNs;
+        serverStats.recordCommand(o.cmd, o.phaseNs, o.error);
+    }
+}
+
+static bool submitRequests(Connection& c, std::vector<Request>& requests);
+
+// Requests a shared-memory session serves before letting the loop's other
+// clients in
+static const int SHM_BATCH = 64;
+
+// Builds a reply in the reply ring, or in the session's pending buffer while
+// the ring is full
+class RingOutput : public FrameOutput {
+public:
+    explicit RingOutput(SharedSession& s) : s(s), inRing(false), bytes(0) {}
+
+    char* reserve(size_t frameBytes) override {
+        if (!s.replies.fits(frameBytes)) return nullptr;
+        bytes = frameBytes;
+        char* frame = s.replies.reserve(frameBytes);
+        inRing = frame != nullptr;
+        if (inRing) return frame;
+        s.pending.resize(frameBytes);
+        return &s.pending[0];
+    }
+
+    SharedSession& s;
+    bool inRing;     // the reply went straight into the ring
+    size_t bytes;
+};
+
+// Answers the requests in the request ring, each reply built in the reply
+// ring where the client reads it. Gives the loop back after SHM_BATCH of
+// them, and stops while a reply waits for room. Returns false if the
+// connection was closed.
+static bool serveSharedMemory(Connection& c) {
+    SharedSession& s = *c.shm;
+    bool wakeClient = false;
+    int served = 0;
+    while (true) {
+        if (!s.pending.empty()) {
+            char* frame = s.replies.reserve(s.pending.size());
+            if (!frame) {
+                if (s.replies.writerMaySleep(s.pending.size())) break;
+                continue;
+            }
+            memcpy(frame, s.pending.data(), s.pending.size());
+            wakeClient |= s.replies.publish(s.pending.size());
+            s.pending.clear();
+        }
+        if (served == SHM_BATCH) {
+            // Comes back through the reactor after the others had their turn
+            ringBell(s.serverBell);
+            break;
+        }
+        const char* request = s.requests.peek();
+        if (!request) {
+            if (s.requests.corrupt()) break;
+            if (s.requests.readerMaySleep()) break;
+            continue;
+        }
+
+        size_t requestBytes = getU32(request);
+        Outcome o;
+        memset(o.phaseNs, 0, sizeof(o.phaseNs));
+        RingOutput out(s);
+        processBinary(request + FRAME_HEADER_BYTES, requestBytes, o.cmd, o.error, o.phaseNs, out);
+        // The request was read in place, so its room is freed only now
+        wakeClient |= s.requests.consume();
+        if (out.inRing) wakeClient |= s.replies.publish(out.bytes);
+        serverStats.bytesIn(FRAME_HEADER_BYTES + requestBytes);
+        serverStats.bytesOut(out.bytes);
+        serverStats.recordCommand(o.cmd, o.phaseNs, o.error);
+        c.lastInputNs = nowNs();
+        ++served;
+    }
+    if (wakeClient) ringBell(s.clientBell);
+    if (s.requests.corrupt()) {
+        std::cout << "Closing connection that corrupted its ring" << std::endl;
+        closeConnection(c);
+        return false;
+    }
+    return true;
+}
+
+// Reactor callback for a session's server eventfd; context is the connection's entry
+static void handleSharedMemory(int bell, int /*events*/, void* context) {
+    uint64_t start = nowNs();
+    Connection& c = *static_cast<Connection*>(context);
+    uint64_t count;
+    while (read(bell, &count, sizeof(count)) > 0) {}
+    bool alive = serveSharedMemory(c);
+
+    uint64_t busy = nowNs() - start;
+    if (alive) c.busyNs += busy;
+    balancer.load(loopIndex).busyNs.fetch_add(busy, std::memory_order_relaxed);
+}
+
+// Whether a request asks to switch to shared memory; sets the ring size asked for
+static bool isShmRequest(const Request& request, size_t& ringBytes) {
+    if (request.binary) return false;
+    std::stringstream ss(request.body);
     std::string command;
+    long long bytes = 0;
+    ss >> command;
+    if (command != "Shm") return false;
+    ringBytes = (ss >> bytes) && bytes > 0 ? (size_t)bytes : SHM_DEFAULT_RING_BYTES;
+    return true;
+}
+
+// Answers "Shm" by handing the client its rings, then serves any requests
+// already in them. Anything after "Shm" on the socket is dropped. Returns
+// false if the connection was closed.
+static bool startSharedMemory(Connection& c, size_t ringBytes) {
+    uint64_t phaseNs[PHASE_COUNT] = {};
+    uint64_t start = nowNs();
+    ringBytes = shmRingBytes(ringBytes);
+    std::string reply = "Shm " + std::to_string(ringBytes) + "\n";
+    const char* failure = nullptr;
+    if (!isLocal(c)) failure = "Shm needs a local connection\n";
+    else if (!reserveSharedSession()) failure = "Shm limit reached\n";
+    else if (!attachSharedMemory(c, ringBytes, reply)) failure = "Shm failed\n";
+    phaseNs[PHASE_COMPUTE] = nowNs() - start;
+    serverStats.recordCommand(CMD_SHM, phaseNs, failure != nullptr);
+    if (failure) {
+        queueOutput(c, failure);
+        return flushConnection(c);
+    }
+    serverStats.bytesOut(reply.size());
+    if (addFdToReactor(reactor, c.shm->serverBell, POLLER_READ | POLLER_EDGE, handleSharedMemory, &c) < 0) {
+        closeConnection(c);
+        return false;
+    }
+    c.in.clear();
+    return serveSharedMemory(c);
+}
+
+// Answers every complete request buffered on the connection with one flush.
+// With worker threads the answers come back later, and reading waits for
+// them. Returns false if the connection was closed.
+static bool serveRequests(Connection& c) {
+    if (c.shm) {
+        c.in.clear();
+        return true;
+    }
+    std::vector<Request> requests;
+    if (!takeRequests(c.in, c.framer, requests)) {
+        queueOutput(c, errorReply(c.framer.binary, "Request too large"));
+        if (flushConnection(c)) closeConnection(c);
+        return false;
+    }
+    if (requests.empty()) return true;
+    size_t ringBytes;
+    if (requests.size() == 1 && c.out.empty() && isShmRequest(requests[0], ringBytes)) return startSharedMemory(c, ringBytes);
+    if (workers.enabled()) return submitRequests(c, requests);
+
+    std::string replies;
+    std::vector<Outcome> outcomes;
+    runRequests(requests, replies, outcomes);
+    uint64_t sendStart = nowNs();
+    queueOutput(c, std::move(replies));
+    bool alive = flushConnection(c);
+    recordOutcomes(outcomes, nowNs() - sendStart);
+    return alive;
+}
+
+// Reads the socket, up to the read budget, and answers the requests that are
+// complete; a partial one waits in c.in for the rest, which also bounds an
+// oversized one to a budget past the limit before it is refused. Returns false
+// if the connection was closed.
+static bool readConnection(Connection& c) {
+    size_t got = 0;
+    bool drained = true;
+    bool open = readAvailable(c, got, drained);
+    if (got > 0) {
+        serverStats.bytesIn(got);
+        c.lastInputNs = nowNs();
+    }
+
+    // The end of the input ends the last request too
+    if (!open && !c.in.empty() && !c.framer.binary) c.in.push_back('\n');
+    if (!serveRequests(c)) return false;
+
+    if (!open) {
+        // Requests still with a worker are answered before the connection goes
+        if (c.inFlight) {
+            c.inputClosed = true;
+            return true;
+        }
+        closeConnection(c);
+        return false;
+    }
+    // Input left in the socket raises no new edge; re-arming reports it on the
+    // next wait, after the loop's other ready connections. A paused or busy
+    // connection reads again when it resumes.
+    if (!drained && !c.readPaused && !c.inFlight) modifyFdInReactor(reactor, c.fd, connectionEvents(c));
+    return true;
+}
+
+// A batch of requests on its way through the worker pool and back to its loop
+struct Job {
+    void* reactor;         // loop that owns the connection
+    int fd;
+    uint64_t connectionId; // tells a reused fd apart from the original connection
+    std::vector<Request> requests;
+    std::string replies;
+    std::vector<Outcome> outcomes;
+};
+
+static void finishJob(void* context);
+
+// Worker thread: runs the commands, then hands the replies back to the loop
+static void runJob(void* context) {
+    Job* job = static_cast<Job*>(context);
+    runRequests(job->requests, job->replies, job->outcomes);
+    runInReactor(job->reactor, finishJob, job);
+}
+
+// Loop thread: sends the replies and reads on, unless the client left meanwhile
+static void finishJob(void* context) {
+    std::unique_ptr<Job> job(static_cast<Job*>(context));
+    auto it = connections.find(job->fd);
+    if (it == connections.end() || it->second.id != job->connectionId) return;
+    Connection& c = it->second;
+    c.inFlight = false;
+
+    uint64_t sendStart = nowNs();
+    queueOutput(c, std::move(job->replies));
+    bool alive = flushConnection(c);
+    recordOutcomes(job->outcomes, nowNs() - sendStart);
+    if (!alive) return;
+
+    if (c.inputClosed) closeConnection(c);
+    // Input that arrived meanwhile is still in the socket
+    else if (!c.readPaused) readConnection(c);
+}
 
+// Hands a batch of requests to the worker pool; one batch per connection is
+// in flight, so replies keep their order. A full queue is answered at once
+// instead. Returns false if the connection was closed.
+static bool submitRequests(Connection& c, std::vector<Request>& requests) {
+    Job* job = new Job{reactor, c.fd, c.id, std::move(requests), std::string(), std::vector<Outcome>()};
+    if (workers.submit(runJob, job)) {
+        c.inFlight = true;
+        return true;
+    }
+    std::string busy;
+    for (const Request& request : job->requests) busy += errorReply(request.binary, "Server busy");
+    delete job;
+    queueOutput(c, std::move(busy));
+    return flushConnection(c);
+}
+
+// Idle timer: closes a connection that has been silent for idleTimeoutMs.
+// Input does not touch the timer; it only moves lastInputNs, and a check
+// that finds recent input rearms for the time left.
+static void idleCheck(void* context) {
+    Connection& c = *static_cast<Connection*>(context);
+    c.idleTimer = 0;
+    uint64_t silentMs = (nowNs() - c.lastInputNs) / 1000000;
+    // Output still draining is left to the write deadline, and a request
+    // with a worker is not idleness
+    if (silentMs < (uint64_t)idleTimeoutMs || !c.out.empty() || c.inFlight) {
+        int remaining = silentMs < (uint64_t)idleTimeoutMs ? idleTimeoutMs - (int)silentMs : idleTimeoutMs;
+        c.idleTimer = addTimerToReactor(reactor, remaining, 0, idleCheck, &c);
+        return;
+    }
+    std::cout << "Closing idle connection" << std::endl;
+    closeConnection(c);
+}
+
+// Write deadline: the client left a reply undelivered for WRITE_DEADLINE_MS
+static void writeDeadline(void* context) {
+    Connection& c = *static_cast<Connection*>(context);
+    c.writeTimer = 0;
+    std::cout << "Closing connection that stopped reading" << std::endl;
+    closeConnection(c);
+}
+
+// Reactor callback for client sockets; context is the connection's entry
+void handleClient(int clientSocket, int events, void* context) {
+    uint64_t start = nowNs();
+    if (!context) {
+        // Registered here by another loop's handoff; adopt it and register
+        // again so later events carry the entry
+        Connection& adopted = connections[clientSocket];
+        adopted = Connection();
+        adopted.fd = clientSocket;
+        adopted.id = ++lastConnectionId;
+        enableZerocopy(adopted);
+        addFdToReactor(reactor, clientSocket, connectionEvents(adopted), handleClient, &adopted);
+        watchConnection(adopted);
+        context = &adopted;
+    }
+    Connection& c = *static_cast<Connection*>(context);
+
+    // Zero-copy completions are reported as an error condition
+    if ((events & POLLER_ERROR) && !c.held.empty()) reapZerocopy(c);
+    bool alive = true;
+    if (c.wantWrite) {
+        bool wasPaused = c.readPaused;
+        alive = flushConnection(c);
+        // Edge-triggered: input that arrived while paused will not be reported again
+        if (alive && wasPaused && !c.readPaused) events |= POLLER_READ;
+    }
+    // A connection with a request at a worker reads again once it is answered
+    if (alive && (events & (POLLER_READ | POLLER_ERROR)) && !c.readPaused && !c.inFlight) {
+        alive = readConnection(c);
+    }
+
+    uint64_t busy = nowNs() - start;
+    if (alive) c.busyNs += busy;
+    balancer.load(loopIndex).busyNs.fetch_add(busy, std::memory_order_relaxed);
+}
+
+// Moves a connection with nothing buffered to another loop. The socket keeps
+// any unread input, and the new loop picks it up when it registers the fd.
+static void handOff(int fd, int target) {
+    void* targetReactor = balancer.load(target).reactor.load(std::memory_order_acquire);
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        unwatchConnection(it->second);
+        removeFdFromReactor(reactor, fd);
+        connections.erase(it);
+    }
+    addFdToReactor(targetReactor, fd, POLLER_READ | POLLER_EDGE, handleClient, nullptr);
+    balancer.handedOff();
+}
+
+// Most connections a hot loop gives away per tick
+static const size_t MAX_HANDOFFS_PER_TICK = 4;
+
+// Runs every BALANCE_TICK_MS on each reactor loop: publishes this loop's load
+// and, if another loop is clearly colder, gives it some idle connections. The
+// busiest connection stays: moving the heavy client would only move the problem.
+void balanceTick() {
+    static thread_local uint64_t lastTick = nowNs();
+    uint64_t now = nowNs();
+    uint64_t queued = 0;
+    for (auto& entry : connections) queued += entry.second.outBytes;
+    balancer.sample(loopIndex, now - lastTick, connections.size(), queued);
+    lastTick = now;
+
+    int target = balancer.colderLoop(loopIndex);
+    if (target >= 0 && connections.size() > 1) {
+        int busiest = -1;
+        uint64_t busiestNs = 0;
+        std::vector<std::pair<uint64_t, int>> idle;
+        for (auto& entry : connections) {
+            const Connection& c = entry.second;
+            if (c.busyNs >= busiestNs) {
+                busiest = c.fd;
+                busiestNs = c.busyNs;
+            }
+            // The new loop frames afresh, as text, so a binary client stays
+            bool movable = c.in.empty() && c.out.empty() && c.held.empty() && !c.shm && !c.framer.binary;
+            if (movable && !c.readPaused && !c.inFlight) idle.emplace_back(c.busyNs, c.fd);
+        }
+        std::sort(idle.begin(), idle.end());
+        size_t moved = 0;
+        for (size_t i = 0; i < idle.size() && moved < MAX_HANDOFFS_PER_TICK; ++i) {
+            if (idle[i].second == busiest) continue;
+            handOff(idle[i].second, target);
+            ++moved;
+        }
+    }
+
+    // Per-connection busy time covers one tick
+    for (auto& entry : connections) entry.second.busyNs = 0;
+}
+
+void acceptConnection(int serverSocket) {
+    // Take every pending connection; the listener is non-blocking
     while (true) {
-        int valread = read(clientSocket, buffer, 1024);
-        if (valread <= 0) {
-            std::cout << "Client disconnected" << std::endl;
-            close(clientSocket);
+        struct sockaddr_storage address;
+        socklen_t addrlen = sizeof(address);
+        int newSocket = accept4(serverSocket, (struct sockaddr *)&address, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (newSocket < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
             return;
         }
 
-        // Process command
-        buffer[valread] = '\0';
-        command = buffer;
-        std::stringstream ss(command);
-        ss >> command;
-
-        if (command == "Newgraph") {
-            ss >> n >> m;
-            edgesMutex.lock();  // Lock mutex before accessing shared data
-            edges.clear();
-            
-            // Read edges directly from command input
-            for (int i = 0; i < m; ++i) {
-                int u, v;
-                if (!(ss >> u >> v)) {
-                    std::cerr << "Error reading edge " << i << std::endl;
-                    break;  // Exit loop on error
-                }
-                edges.push_back({u, v});
-            }
-            edgesMutex.unlock();  // Unlock mutex after accessing shared data
-            std::string response = "Graph updated\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
-
-        } else if (command == "Kosaraju") {
-            edgesMutex.lock();  // Lock mutex before accessing shared data
-            std::vector<std::vector<int>> sccs = kosaraju(n, edges);
-            edgesMutex.unlock();  // Unlock mutex after accessing shared data
-
-            std::stringstream response;
-            response << "scc:\n";
-            for (const auto& scc : sccs) {
-                for (int v : scc) {
-                    response << v << " ";
-                }
-                response << "\n";
-            }
-            send(clientSocket, response.str().c_str(), response.str().length(), 0);
+        // Print client connection information
+        printPeer(address);
+        serverStats.connectionOpened();
 
-        } else if (command == "Newedge") {
-            int u, v;
-            ss >> u >> v;
-            edgesMutex.lock();  // Lock mutex before accessing shared data
-            edges.emplace_back(u, v);
-            edgesMutex.unlock();  // Unlock mutex after accessing shared data
-            std::string response = "Edge added\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
-
-        } else if (command == "Removeedge") {
-            int u, v;
-            ss >> u >> v;
-            edgesMutex.lock();  // Lock mutex before accessing shared data
-            auto it = std::find(edges.begin(), edges.end(), std::make_pair(u, v));
-            if (it != edges.end()) {
-                edges.erase(it);
-                std::cout << "Edge " << u << " -> " << v << " removed" << std::endl; // Print statement after removing an edge
+        // Steer the connection to a clearly colder loop instead of taking it
+        if (balancing) {
+            int target = balancer.colderLoop(loopIndex);
+            if (target >= 0) {
+                handOff(newSocket, target);
+                continue;
             }
-            edgesMutex.unlock();  // Unlock mutex after accessing shared data
-            std::string response = "Edge removed\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
+        }
 
-        } else {
-            // Invalid command
-            std::string error = "Invalid command\n";
-            send(clientSocket, error.c_str(), error.length(), 0);
+        // The reactor thread serves the client; no thread per connection
+        Connection& c = connections[newSocket];
+        c = Connection();
+        c.fd = newSocket;
+        c.id = ++lastConnectionId;
+        enableZerocopy(c);
+        if (addFdToReactor(reactor, newSocket, connectionEvents(c), handleClient, &c) < 0) {
+            serverStats.connectionClosed();
+            connections.erase(newSocket);
+            close(newSocket);
+            continue;
         }
+        watchConnection(c);
     }
 }
 
-void acceptConnection(int serverSocket) {
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
-    int newSocket;
-    
-    if ((newSocket = accept(serverSocket, (struct sockaddr *)&address, (socklen_t*)&addrlen))<0) {
-        perror("accept");
+// How long a scrape may take to send its request or read the reply
+const int METRICS_TIMEOUT_MS = 1000;
+
+// Answers one HTTP scrape on an accepted metrics connection
+void serveMetrics(int scraper) {
+    // A stalled scraper holds up the next scrape, never a client
+    struct timeval timeout = {METRICS_TIMEOUT_MS / 1000, (METRICS_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(scraper, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(scraper, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    // The request itself is ignored; every path returns the metrics
+    char request[1024];
+    if (read(scraper, request, sizeof(request)) > 0) {
+        std::string body = serverStats.prometheus() + balancer.prometheus() + workers.prometheus();
+        std::string reply = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                            std::to_string(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+        send(scraper, reply.c_str(), reply.length(), MSG_NOSIGNAL);
+    }
+    close(scraper);
+}
+
+// Metrics thread for -m: answers scrapes one at a time, off the event
+// loops, which never wait on a scraper
+static void acceptMetrics(int metricsSocket) {
+    while (true) {
+        int scraper = accept4(metricsSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (scraper < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            // Out of descriptors, most likely; give the loops time to free some
+            std::this_thread::sleep_for(std::chrono::milliseconds(METRICS_TIMEOUT_MS));
+            continue;
+        }
+        serveMetrics(scraper);
+    }
+}
+
+// Proactor of the calling event loop thread when running on io_uring
+thread_local void* proactor = nullptr;
+
+// Input of a proactor client not yet framed into whole requests
+struct ProactorInput {
+    std::string in;
+    RequestFramer framer;
+};
+thread_local std::unordered_map<int, ProactorInput> proactorInputs;
+
+// Proactor callback with the input of one batch of receive completions
+void handleProactorClient(int clientSocket, const char* data, size_t len) {
+    if (len == 0) {
+        proactorInputs.erase(clientSocket);
+        std::cout << "Client disconnected" << std::endl;
+        serverStats.connectionClosed();
         return;
     }
+    serverStats.bytesIn(len);
+
+    ProactorInput& input = proactorInputs[clientSocket];
+    input.in.append(data, len);
+    std::vector<Request> requests;
+    std::string replies;
+    std::vector<Outcome> outcomes;
+    bool framed = takeRequests(input.in, input.framer, requests);
+    runRequests(requests, replies, outcomes);
+    if (!framed) {
+        // The oversized request is dropped and framing starts over, in the
+        // protocol the client speaks
+        bool binary = input.framer.binary;
+        replies += errorReply(binary, "Request too large");
+        input.in.clear();
+        input.framer = RequestFramer();
+        input.framer.binary = binary;
+    }
+    if (replies.empty()) return;
+
+    // The send is only queued here; it goes out with the next submission
+    uint64_t sendStart = nowNs();
+    size_t size = replies.size();
+    if (sendToProactor(proactor, clientSocket, std::move(replies)) == 0) serverStats.bytesOut(size);
+    recordOutcomes(outcomes, nowNs() - sendStart);
+}
+
+// Prints where an accepted connection comes from
+static void printPeer(int fd) {
+    struct sockaddr_storage address;
+    socklen_t addrlen = sizeof(address);
+    if (getpeername(fd, (struct sockaddr *)&address, &addrlen) < 0) address.ss_family = AF_UNSPEC;
+    printPeer(address);
+}
+
+void acceptProactorClient(int /*serverSocket*/, int newSocket) {
+    printPeer(newSocket);
+    serverStats.connectionOpened();
+
+    if (addFdToProactor(proactor, newSocket, handleProactorClient) < 0) {
+        serverStats.connectionClosed();
+        close(newSocket);
+    }
+}
 
-    // Print client connection information
-    char clientAddr[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(address.sin_addr), clientAddr, INET_ADDRSTRLEN);
-    std::cout << "New connection from " << clientAddr << ":" << ntohs(address.sin_port) << std::endl;
+#if defined(__cpp_impl_coroutine)
+// Serves one client as plain sequential code. Each co_await suspends the
+// coroutine until the reactor reports the socket ready, so between requests
+// a client costs its frame and nothing else.
+static Task serveClient(int clientSocket) {
+    AsyncFd client(reactor, clientSocket);
+    std::string in;
+    RequestFramer framer;
+    while (true) {
+        ssize_t got = co_await client.read(in, READ_BUDGET_BYTES);
+        if (got > 0) serverStats.bytesIn(got);
+        // The end of the input ends the last request too
+        else if (got == 0 && !in.empty() && !framer.binary) in.push_back('\n');
 
-    // Handle client in a new thread
-    std::thread clientThread(handleClient, newSocket);
-    clientThread.detach();
+        std::vector<Request> requests;
+        if (!takeRequests(in, framer, requests)) {
+            std::string reply = errorReply(framer.binary, "Request too large");
+            co_await client.write(reply.data(), reply.size());
+            break;
+        }
+        if (!requests.empty()) {
+            std::string replies;
+            std::vector<Outcome> outcomes;
+            runRequests(requests, replies, outcomes);
+            uint64_t sendStart = nowNs();
+            ssize_t sent = co_await client.write(replies.data(), replies.size());
+            recordOutcomes(outcomes, nowNs() - sendStart);
+            if (sent < 0) break;
+            serverStats.bytesOut(sent);
+        }
+        if (got <= 0) break;
+    }
+    std::cout << "Client disconnected" << std::endl;
+    serverStats.connectionClosed();
 }
 
-int main() {
+// Accepts clients and starts a coroutine for each; runs for the life of the loop
+static Task acceptClients(int serverSocket) {
+    AsyncFd listener(reactor, serverSocket);
+    while (true) {
+        int clientSocket = co_await listener.accept();
+        if (clientSocket < 0) {
+            perror("accept");
+            break;
+        }
+        printPeer(clientSocket);
+        serverStats.connectionOpened();
+        serveClient(clientSocket);
+    }
+}
+#endif
+
+// Opens the metrics listener on 127.0.0.1:port
+int openMetricsListener(int port) {
+    int metricsSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (metricsSocket < 0) {
+        perror("metrics socket");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(metricsSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    if (bind(metricsSocket, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(metricsSocket, 16) < 0) {
+        perror("metrics listener");
+        close(metricsSocket);
+        return -1;
+    }
+    return metricsSocket;
+}
+
+// Opens the Unix domain listener at path, replacing a socket a previous run
+// left there. There is one for all event loops; each watches it, and the
+// first to wake takes the connection.
+int openUnixListener(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        std::cerr << "Unix socket path too long: " << path << std::endl;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int unixSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (unixSocket < 0) {
+        perror("unix socket");
+        return -1;
+    }
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+    if (bind(unixSocket, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(unixSocket, SOMAXCONN) < 0) {
+        perror("unix listener");
+        close(unixSocket);
+        return -1;
+    }
+    return unixSocket;
+}
+
+// Opens a listening socket on port. SO_REUSEPORT lets every event loop bind
+// its own, and the kernel spreads incoming connections across them.
+int openListener(int port) {
     int serverSocket;
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
 
     // Creating socket file descriptor
-    if ((serverSocket = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((serverSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         perror("socket failed");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    // Forcefully attaching socket to the port 9034
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
         perror("setsockopt");
-        exit(EXIT_FAILURE);
+        close(serverSocket);
+        return -1;
     }
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(9034);
+    address.sin_port = htons(port);
 
-    // Forcefully attaching socket to the port 9034
+    // Forcefully attaching socket to the port
     if (bind(serverSocket, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("bind failed");
-        exit(EXIT_FAILURE);
+        close(serverSocket);
+        return -1;
     }
 
-    if (listen(serverSocket, 3) < 0) {
+    if (listen(serverSocket, SOMAXCONN) < 0) {
         perror("listen");
-        exit(EXIT_FAILURE);
+        close(serverSocket);
+        return -1;
+    }
+    return serverSocket;
+}
+
+// Pins the calling thread to the index-th CPU it is allowed to run on
+static void pinToCpu(int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0) return;
+    int target = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- > 0) continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(one), &one) != 0) perror("pthread_setaffinity_np");
+        return;
+    }
+}
+
+// Settings shared by every event loop
+struct LoopConfig {
+    ReactorBackend backend;
+    bool useUring;
+    bool pin;
+    bool coroutines;     // clients served by coroutines instead of callbacks
+    int unixSocket;      // shared by every loop, -1 without one
+};
+
+// One event loop: its own listener, reactor (or proactor) and connections
+void runEventLoop(int index, LoopConfig config) {
+    loopIndex = index;
+    if (config.pin) pinToCpu(index);
+
+    int serverSocket = openListener(9034);
+    if (serverSocket < 0) return;
+
+    if (config.useUring) {
+        proactor = startProactor();
+        if (proactor) {
+            if (index == 0) std::cout << "Proactor backend: io_uring" << std::endl;
+            addListenerToProactor(proactor, serverSocket, acceptProactorClient);
+            if (config.unixSocket >= 0) addListenerToProactor(proactor, config.unixSocket, acceptProactorClient);
+            static_cast<Proactor*>(proactor)->run();
+            stopProactor(proactor);
+            return;
+        }
+        if (index == 0) std::cerr << "io_uring is not available, falling back to epoll" << std::endl;
+    }
+
+    setNonBlocking(serverSocket);
+    reactor = startReactor(config.backend);
+    if (index == 0) std::cout << "Reactor backend: " << static_cast<Reactor*>(reactor)->backendName() << std::endl;
+    for (int listener : {serverSocket, config.unixSocket}) {
+        if (listener < 0) continue;
+#if defined(__cpp_impl_coroutine)
+        if (config.coroutines) acceptClients(listener);
+        else addFdToReactor(reactor, listener, acceptConnection);
+#else
+        addFdToReactor(reactor, listener, acceptConnection);
+#endif
     }
 
-    void* reactor = startReactor();
-    addFdToReactor(reactor, serverSocket, acceptConnection);
-    
     Reactor* r = static_cast<Reactor*>(reactor);
+    if (balancing) {
+        balancer.registerLoop(index, reactor);
+        r->setTick(BALANCE_TICK_MS, balanceTick);
+    }
     r->run();
 
     stopReactor(reactor);
+}
+
+int main(int argc, char* argv[]) {
+    int metricsPort = 0;
+    int loops = 1;
+    const char* unixPath = nullptr;
+    const char* labelsName = nullptr;
+    LoopConfig config = {BACKEND_EPOLL, false, false, false, -1};
+
+    // -m <port> serves Prometheus metrics over HTTP on localhost
+    // -b <select|poll|epoll|uring> picks the reactor backend, or the io_uring proactor
+    // -t <n> runs n event loops, each on its own thread and listener
+    // -p pins each event loop thread to its own CPU
+    // -i <seconds> disconnects clients idle that long, 0 never (reactor loops)
+    // -c serves clients with coroutines on the reactor (C++20 builds)
+    // -w <n> runs commands on n worker threads instead of the event loops
+    // -q <n> queues at most n commands for the workers, refusing more (default 1024)
+    // -u <path> also listens on a Unix domain socket for local clients, which
+    //    may move to shared-memory rings with "Shm" (see shm.hpp)
+    // -L <name> publishes component labels in shared-memory object name (see labels.hpp)
+    int workerThreads = 0;
+    size_t workerQueue = 1024;
+    int c;
+    while ((c = getopt(argc, argv, "m:b:t:pi:cw:q:u:L:")) != -1) {
+        switch (c) {
+            case 'm':
+                metricsPort = atoi(optarg);
+                break;
+            case 't':
+                loops = atoi(optarg);
+                if (loops < 1) loops = 1;
+                break;
+            case 'p':
+                config.pin = true;
+                break;
+            case 'i':
+                idleTimeoutMs = atoi(optarg) * 1000;
+                if (idleTimeoutMs < 0) idleTimeoutMs = 0;
+                break;
+            case 'w':
+                workerThreads = atoi(optarg);
+                break;
+            case 'q':
+                workerQueue = (size_t)atol(optarg);
+                if (workerQueue < 1) workerQueue = 1;
+                break;
+            case 'u':
+                unixPath = optarg;
+                break;
+            case 'L':
+                labelsName = optarg;
+                break;
+            case 'c':
+#if defined(__cpp_impl_coroutine)
+                config.coroutines = true;
+                break;
+#else
+                std::cerr << "-c needs a C++20 build" << std::endl;
+                exit(EXIT_FAILURE);
+#endif
+            case 'b':
+                config.useUring = strcmp(optarg, "uring") == 0;
+                if (config.useUring || parseBackend(optarg, config.backend)) break;
+                // fall through
+            default:
+                std::cerr << "Usage: " << argv[0] << " [-m metrics_port] [-b select|poll|epoll|uring] [-t loops] [-p]"
+                          << " [-i idle_seconds] [-c] [-w workers] [-q queue_limit] [-u unix_path]"
+                          << " [-L labels_name]" << std::endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (metricsPort > 0) {
+        int metricsSocket = openMetricsListener(metricsPort);
+        if (metricsSocket >= 0) {
+            std::thread(acceptMetrics, metricsSocket).detach();
+            std::cout << "Metrics on http://127.0.0.1:" << metricsPort << "/metrics" << std::endl;
+        }
+    }
+    if (unixPath) {
+        config.unixSocket = openUnixListener(unixPath);
+        if (config.unixSocket < 0) exit(EXIT_FAILURE);
+        // Reactor loops accept until EAGAIN; io_uring waits for connections itself
+        if (!config.useUring) setNonBlocking(config.unixSocket);
+        std::cout << "Listening on " << unixPath << std::endl;
+    }
+    if (labelsName) {
+        if (!labelPublisher.open(labelsName, instanceId)) {
+            perror("shm_open");
+            exit(EXIT_FAILURE);
+        }
+        std::thread(publishLabels).detach();
+        std::cout << "Publishing labels in " << labelsName << std::endl;
+    }
+    // Commands from the reactor loops' callback clients go through the pool
+    if (workerThreads > 0) {
+        workers.start(workerThreads, workerQueue);
+        std::cout << "Worker threads: " << workerThreads << ", queue limit " << workerQueue << std::endl;
+    }
+    std::cout << "Event loops: " << loops << (config.pin ? " (pinned)" : "") << std::endl;
+
+    // Reactor loops rebalance connections among themselves; proactor loops and
+    // coroutine clients, whose state lives in a suspended frame, do not
+    balancing = loops > 1 && !config.useUring && !config.coroutines;
+
+    // Loop 0 runs on the main thread
+    std::vector<std::thread> threads;
+    for (int i = 1; i < loops; ++i) threads.emplace_back(runEventLoop, i, config);
+    runEventLoop(0, config);
 
+    for (auto& t : threads) t.join();
     return 0;
 }
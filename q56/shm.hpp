@@ -0,0 +1,195 @@
+#ifndef SHM_HPP
+#define SHM_HPP
+
+// Shared-memory transport for local bulk clients. On a Unix domain socket
+// connection, the text command "Shm [bytes]" asks for it, sent on its own
+// with no other request outstanding. The server answers "Shm <bytes>" with
+// three descriptors attached (SCM_RIGHTS): a memfd holding a request ring and
+// a reply ring of that many bytes each, the eventfd that wakes the server and
+// the eventfd that wakes the client. From then on requests go into the
+// request ring and replies come out of the reply ring, both as frames of the
+// binary protocol (see binary.hpp); the socket carries nothing more, and
+// closing it ends the session.
+//
+// Each ring has one writer and one reader, which only ever move their own
+// position forward. Frames start on 8-byte boundaries and never wrap: one
+// that does not fit before the end of the ring is written at its start, and
+// a skip marker sends the reader there. So a frame is always read where it
+// was written, and may take up to half the ring. A side that finds nothing
+// to read, or no room to write, raises its waiting flag and sleeps on its
+// eventfd; the other side rings that eventfd only when it sees the flag.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+#include "binary.hpp"
+
+// Ring sizes a client may ask for; others are rounded into this range and up
+// to a power of two. The server populates both rings on its loop thread.
+const size_t SHM_MIN_RING_BYTES = 64 << 10;
+const size_t SHM_MAX_RING_BYTES = 64 << 20;
+// Ring size when the client names none
+const size_t SHM_DEFAULT_RING_BYTES = 8 << 20;
+// Sessions a server keeps at once, on all its loops; with the largest rings
+// they pin 2 GiB
+const int SHM_MAX_SESSIONS = 16;
+
+// Bytes before the rings' data, holding both ring headers
+const size_t SHM_HEADER_BYTES = 4096;
+
+// Length prefix that sends the reader to the start of the ring
+const uint32_t SHM_SKIP = 0xffffffff;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be lock-free to be shared");
+
+// One side of a ring, on a cache line of its own
+struct alignas(64) RingSide {
+    std::atomic<uint64_t> position;   // bytes written, or read, since the start
+    std::atomic<uint32_t> waiting;    // this side sleeps until its eventfd is rung
+};
+
+struct RingHeader {
+    RingSide writer;
+    RingSide reader;
+};
+
+// Bytes the memfd holds for two rings of ringBytes
+inline size_t shmMappedBytes(size_t ringBytes) {
+    return SHM_HEADER_BYTES + 2 * ringBytes;
+}
+
+// Rounds a requested ring size to one the transport uses
+inline size_t shmRingBytes(size_t requested) {
+    size_t bytes = SHM_MIN_RING_BYTES;
+    while (bytes < requested && bytes < SHM_MAX_RING_BYTES) bytes <<= 1;
+    return bytes;
+}
+
+// Wakes the side sleeping on bell
+inline void ringBell(int bell) {
+    uint64_t one = 1;
+    ssize_t ignored = write(bell, &one, sizeof(one));
+    (void)ignored;
+}
+
+// This process's end of one ring, as its writer or as its reader; each end
+// keeps its own cached copy of the other side's position
+class ShmRing {
+public:
+    ShmRing() : header(nullptr), data(nullptr), capacity(0), other(0), skipped(0), frameBytes(0), broken(false) {}
+    ShmRing(RingHeader* header, char* data, size_t capacity)
+        : header(header), data(data), capacity(capacity), other(0), skipped(0), frameBytes(0), broken(false) {}
+
+    // Whether a frame of this many bytes, length prefix included, can ever fit
+    bool fits(size_t bytes) const { return align(bytes) <= capacity / 2; }
+
+    // Writer: room for a frame of bytes at the next position, or nullptr
+    // while the reader has not freed enough. The frame goes to the reader
+    // once published.
+    char* reserve(size_t bytes) {
+        if (!fits(bytes)) return nullptr;
+        uint64_t tail = header->writer.position.load(std::memory_order_relaxed);
+        size_t offset = tail & (capacity - 1);
+        size_t need = align(bytes);
+        size_t skip = capacity - offset < need ? capacity - offset : 0;
+        if (tail + skip + need - other > capacity) {
+            other = header->reader.position.load(std::memory_order_seq_cst);
+            if (tail + skip + need - other > capacity) return nullptr;
+        }
+        if (skip) putU32(data + offset, SHM_SKIP);
+        skipped = skip;
+        return data + (skip ? 0 : offset);
+    }
+
+    // Writer: hands the frame of bytes reserved last to the reader. True if
+    // the reader sleeps and its bell must be rung.
+    bool publish(size_t bytes) {
+        uint64_t tail = header->writer.position.load(std::memory_order_relaxed) + skipped + align(bytes);
+        skipped = 0;
+        header->writer.position.store(tail, std::memory_order_seq_cst);
+        return header->reader.waiting.load(std::memory_order_seq_cst) &&
+               header->reader.waiting.exchange(0, std::memory_order_seq_cst);
+    }
+
+    // Reader: the next frame, from its length prefix on, or nullptr if none
+    // is published or the writer broke the format (see corrupt()). The frame
+    // stays in place until consumed.
+    const char* peek() {
+        uint64_t head = header->reader.position.load(std::memory_order_relaxed);
+        skipped = 0;
+        while (true) {
+            if (head + skipped == other) {
+                other = header->writer.position.load(std::memory_order_seq_cst);
+                if (head + skipped == other) return nullptr;
+            }
+            uint64_t available = other - head - skipped;
+            size_t offset = (head + skipped) & (capacity - 1);
+            if (available > capacity || available < FRAME_HEADER_BYTES) break;
+            uint32_t length = getU32(data + offset);
+            if (length == SHM_SKIP && skipped == 0 && offset != 0) {
+                skipped = capacity - offset;
+                continue;
+            }
+            frameBytes = FRAME_HEADER_BYTES + (size_t)length;
+            if (length == 0 || !fits(frameBytes) || offset + align(frameBytes) > capacity || align(frameBytes) > available) break;
+            return data + offset;
+        }
+        broken = true;
+        return nullptr;
+    }
+
+    // Reader: frees the frame peeked last. True if the writer sleeps and its
+    // bell must be rung.
+    bool consume() {
+        uint64_t head = header->reader.position.load(std::memory_order_relaxed) + skipped + align(frameBytes);
+        skipped = frameBytes = 0;
+        header->reader.position.store(head, std::memory_order_seq_cst);
+        return header->writer.waiting.load(std::memory_order_seq_cst) &&
+               header->writer.waiting.exchange(0, std::memory_order_seq_cst);
+    }
+
+    // Reader with nothing to read: raises its flag and looks once more, so a
+    // frame published meanwhile is not slept through. True if it may sleep.
+    bool readerMaySleep() {
+        header->reader.waiting.store(1, std::memory_order_seq_cst);
+        if (peek() || broken) {
+            header->reader.waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Writer without room for bytes: the same, waiting for the reader
+    bool writerMaySleep(size_t bytes) {
+        header->writer.waiting.store(1, std::memory_order_seq_cst);
+        if (reserve(bytes)) {
+            header->writer.waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // The other side wrote something that is not a frame
+    bool corrupt() const { return broken; }
+
+private:
+    static size_t align(size_t bytes) { return (bytes + 7) & ~(size_t)7; }
+
+    RingHeader* header;
+    char* data;
+    size_t capacity;     // a power of two
+    uint64_t other;      // last position seen of the other side
+    size_t skipped;      // bytes skipped to reach the frame reserved or peeked
+    size_t frameBytes;   // reader: size of the frame peeked
+    bool broken;
+};
+
+// The two rings in a mapping of shmMappedBytes(ringBytes) bytes
+inline void shmRings(char* base, size_t ringBytes, ShmRing& requests, ShmRing& replies) {
+    RingHeader* headers = reinterpret_cast<RingHeader*>(base);
+    requests = ShmRing(&headers[0], base + SHM_HEADER_BYTES, ringBytes);
+    replies = ShmRing(&headers[1], base + SHM_HEADER_BYTES + ringBytes, ringBytes);
+}
+
+#endif // SHM_HPP
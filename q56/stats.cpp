@@ -0,0 +1,189 @@
+#include "stats.hpp"
+#include <sstream>
+#include <time.h>
+
+ServerStats serverStats;
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+const char* commandName(Command cmd) {
+    switch (cmd) {
+        case CMD_NEWGRAPH: return "Newgraph";
+        case CMD_KOSARAJU: return "Kosaraju";
+        case CMD_SCCSTATS: return "Sccstats";
+        case CMD_NEWEDGE: return "Newedge";
+        case CMD_REMOVEEDGE: return "Removeedge";
+        case CMD_STATS: return "Stats";
+        case CMD_EXPLAIN: return "Explain";
+        case CMD_BINARY: return "Binary";
+        case CMD_SHM: return "Shm";
+        default: return "Invalid";
+    }
+}
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+        case PHASE_PARSE: return "parse";
+        case PHASE_LOCK_WAIT: return "lock_wait";
+        case PHASE_COMPUTE: return "compute";
+        default: return "send";
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : samples(0), total(0), largest(0) {
+    for (int i = 0; i < BUCKETS; ++i) buckets[i].store(0, std::memory_order_relaxed);
+}
+
+// Records one sample
+void LatencyHistogram::record(uint64_t ns) {
+    // Bucket i holds samples in [2^i, 2^(i+1)) nanoseconds
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t prev = largest.load(std::memory_order_relaxed);
+    while (ns > prev && !largest.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::count() const {
+    return samples.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::sum() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const {
+    return largest.load(std::memory_order_relaxed);
+}
+
+// Upper bound of the bucket holding the given quantile (0..1)
+uint64_t LatencyHistogram::quantile(double q) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)(n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t upper = (i + 1 < 64) ? (1ull << (i + 1)) : UINT64_MAX;
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+ServerStats::ServerStats()
+    : startNs(nowNs()), connectionsTotal(0), connectionsActive(0), inBytes(0), outBytes(0),
+      vertices(0), edgeCount(0), version(0) {}
+
+void ServerStats::connectionOpened() {
+    connectionsTotal.fetch_add(1, std::memory_order_relaxed);
+    connectionsActive.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerStats::connectionClosed() {
+    connectionsActive.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ServerStats::bytesIn(uint64_t bytes) {
+    inBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ServerStats::bytesOut(uint64_t bytes) {
+    outBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// Records the graph size after a mutation and bumps the graph version
+void ServerStats::graphChanged(int n, uint64_t m) {
+    vertices.store(n, std::memory_order_relaxed);
+    edgeCount.store(m, std::memory_order_relaxed);
+    version.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Records a finished request; phaseNs holds PHASE_COUNT durations
+void ServerStats::recordCommand(Command cmd, const uint64_t* phaseNs, bool error) {
+    CommandStats& cs = commands[cmd];
+    cs.calls.fetch_add(1, std::memory_order_relaxed);
+    if (error) cs.errors.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t whole = 0;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        cs.phases[p].record(phaseNs[p]);
+        whole += phaseNs[p];
+    }
+    cs.latency.record(whole);
+}
+
+uint64_t ServerStats::graphVersion() const {
+    return version.load(std::memory_order_relaxed);
+}
+
+// Plain text report for the Stats command
+std::string ServerStats::report() const {
+    std::stringstream out;
+    out << "stats:\n";
+    out << "uptime_s " << (nowNs() - startNs) / 1000000000ull << "\n";
+    out << "connections_total " << connectionsTotal.load() << "\n";
+    out << "connections_active " << connectionsActive.load() << "\n";
+    out << "bytes_in " << inBytes.load() << "\n";
+    out << "bytes_out " << outBytes.load() << "\n";
+    out << "graph_vertices " << vertices.load() << "\n";
+    out << "graph_edges " << edgeCount.load() << "\n";
+    out << "graph_version " << version.load() << "\n";
+
+    for (int c = 0; c < CMD_COUNT; ++c) {
+        const CommandStats& cs = commands[c];
+        uint64_t calls = cs.calls.load();
+        if (calls == 0) continue;
+        out << commandName((Command)c) << " calls " << calls << " errors " << cs.errors.load()
+            << " p50_us " << cs.latency.quantile(0.5) / 1000
+            << " p99_us " << cs.latency.quantile(0.99) / 1000
+            << " max_us " << cs.latency.max() / 1000 << "\n";
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const LatencyHistogram& h = cs.phases[p];
+            out << "  " << phaseName((Phase)p)
+                << " p50_us " << h.quantile(0.5) / 1000
+                << " p99_us " << h.quantile(0.99) / 1000
+                << " max_us " << h.max() / 1000 << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Prometheus text exposition for the metrics listener
+std::string ServerStats::prometheus() const {
+    std::stringstream out;
+    out << "scc_uptime_seconds " << (nowNs() - startNs) / 1000000000ull << "\n";
+    out << "scc_connections_total " << connectionsTotal.load() << "\n";
+    out << "scc_connections_active " << connectionsActive.load() << "\n";
+    out << "scc_bytes_in_total " << inBytes.load() << "\n";
+    out << "scc_bytes_out_total " << outBytes.load() << "\n";
+    out << "scc_graph_vertices " << vertices.load() << "\n";
+    out << "scc_graph_edges " << edgeCount.load() << "\n";
+    out << "scc_graph_version " << version.load() << "\n";
+
+    for (int c = 0; c < CMD_COUNT; ++c) {
+        const CommandStats& cs = commands[c];
+        const char* name = commandName((Command)c);
+        out << "scc_command_calls_total{command=\"" << name << "\"} " << cs.calls.load() << "\n";
+        out << "scc_command_errors_total{command=\"" << name << "\"} " << cs.errors.load() << "\n";
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const LatencyHistogram& h = cs.phases[p];
+            if (h.count() == 0) continue;
+            std::string labels = std::string("command=\"") + name + "\",phase=\"" + phaseName((Phase)p) + "\"";
+            out << "scc_phase_seconds_count{" << labels << "} " << h.count() << "\n";
+            out << "scc_phase_seconds_sum{" << labels << "} " << h.sum() / 1e9 << "\n";
+            out << "scc_phase_seconds{" << labels << ",quantile=\"0.5\"} " << h.quantile(0.5) / 1e9 << "\n";
+            out << "scc_phase_seconds{" << labels << ",quantile=\"0.99\"} " << h.quantile(0.99) / 1e9 << "\n";
+        }
+    }
+    return out.str();
+}
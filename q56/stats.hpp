@@ -0,0 +1,112 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Commands understood by the server
+enum Command {
+    CMD_NEWGRAPH,
+    CMD_KOSARAJU,
+    CMD_SCCSTATS,
+    CMD_NEWEDGE,
+    CMD_REMOVEEDGE,
+    CMD_STATS,
+    CMD_EXPLAIN,
+    CMD_BINARY,
+    CMD_SHM,
+    CMD_INVALID,
+    CMD_COUNT
+};
+
+// Phases of a single request
+enum Phase {
+    PHASE_PARSE,
+    PHASE_LOCK_WAIT,
+    PHASE_COMPUTE,
+    PHASE_SEND,
+    PHASE_COUNT
+};
+
+// Returns a monotonic timestamp in nanoseconds
+uint64_t nowNs();
+
+// Lock-free latency histogram with power-of-two nanosecond buckets.
+// Recording is a handful of relaxed atomic adds, so it can stay on in production.
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 40;
+
+    LatencyHistogram();
+
+    // Records one sample
+    void record(uint64_t ns);
+
+    uint64_t count() const;
+    uint64_t sum() const;
+    uint64_t max() const;
+
+    // Upper bound of the bucket holding the given quantile (0..1)
+    uint64_t quantile(double q) const;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> largest;
+};
+
+// Per-command counters
+struct CommandStats {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> errors{0};
+    LatencyHistogram phases[PHASE_COUNT];
+    LatencyHistogram latency; // whole request, parse to send
+};
+
+// Process-wide server statistics
+class ServerStats {
+public:
+    ServerStats();
+
+    void connectionOpened();
+    void connectionClosed();
+    void bytesIn(uint64_t bytes);
+    void bytesOut(uint64_t bytes);
+
+    // Records the graph size after a mutation and bumps the graph version
+    void graphChanged(int vertices, uint64_t edgeCount);
+
+    // Records a finished request; phaseNs holds PHASE_COUNT durations
+    void recordCommand(Command cmd, const uint64_t* phaseNs, bool error);
+
+    uint64_t graphVersion() const;
+
+    // Plain text report for the Stats command
+    std::string report() const;
+
+    // Prometheus text exposition for the metrics listener
+    std::string prometheus() const;
+
+private:
+    uint64_t startNs;
+    std::atomic<uint64_t> connectionsTotal;
+    std::atomic<int64_t> connectionsActive;
+    std::atomic<uint64_t> inBytes;
+    std::atomic<uint64_t> outBytes;
+    std::atomic<int64_t> vertices;
+    std::atomic<uint64_t> edgeCount;
+    std::atomic<uint64_t> version;
+    CommandStats commands[CMD_COUNT];
+};
+
+// Name of a command as used on the wire
+const char* commandName(Command cmd);
+
+// Name of a request phase
+const char* phaseName(Phase phase);
+
+extern ServerStats serverStats;
+
+#endif // STATS_HPP
@@ -0,0 +1,164 @@
+#include "timer.hpp"
+#include <climits>
+
+TimerWheel::TimerWheel(uint64_t nowMs) : freeList(NONE), current(nowMs), count(0) {
+    nodes.resize(LEVELS * SLOTS);
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].prev = nodes[i].next = i;  // empty slot lists point at themselves
+        nodes[i].func = nullptr;
+    }
+    for (int level = 0; level < LEVELS; ++level) occupied[level] = 0;
+}
+
+// Runs func(context) delayMs after nowMs, then every intervalMs
+TimerId TimerWheel::schedule(uint64_t nowMs, uint64_t delayMs, uint64_t intervalMs, timerFunc func, void* context) {
+    if (!func) return 0;
+    uint32_t index;
+    if (freeList != NONE) {
+        index = freeList;
+        freeList = nodes[index].next;
+    } else {
+        index = (uint32_t)nodes.size();
+        nodes.push_back(Node{NONE, NONE, 1, 0, 0, nullptr, nullptr});
+    }
+    Node& n = nodes[index];
+    // The current tick has been processed already, so the earliest is the next one
+    n.expires = (nowMs > current ? nowMs : current) + (delayMs > 0 ? delayMs : 1);
+    n.intervalMs = intervalMs;
+    n.func = func;
+    n.context = context;
+    place(index);
+    ++count;
+    return (uint64_t)n.generation << 32 | index;
+}
+
+// Stops a timer; false if it already fired (one-shot) or was cancelled
+bool TimerWheel::cancel(TimerId id) {
+    uint32_t index = (uint32_t)id;
+    if (index < LEVELS * SLOTS || index >= nodes.size()) return false;
+    Node& n = nodes[index];
+    if (!n.func || n.generation != (uint32_t)(id >> 32)) return false;
+    unlink(index);
+    release(index);
+    return true;
+}
+
+// Puts a timer in the slot of the lowest level whose span reaches its expiry
+void TimerWheel::place(uint32_t index) {
+    uint64_t expires = nodes[index].expires;
+    uint64_t delta = expires > current ? expires - current : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t)1 << (SLOT_BITS * (level + 1))) ++level;
+    uint64_t slot = expires >> (SLOT_BITS * level);
+    // Past the top level's span: park it in the slot reached last and let
+    // that cascade place it again
+    if (delta >= (uint64_t)1 << (SLOT_BITS * LEVELS)) slot = current >> (SLOT_BITS * level);
+    link(level * SLOTS + (uint32_t)(slot & (SLOTS - 1)), index);
+}
+
+void TimerWheel::link(uint32_t head, uint32_t index) {
+    Node& n = nodes[index];
+    n.prev = head;
+    n.next = nodes[head].next;
+    nodes[n.next].prev = index;
+    nodes[head].next = index;
+    occupied[head / SLOTS] |= (uint64_t)1 << (head % SLOTS);
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& n = nodes[index];
+    nodes[n.prev].next = n.next;
+    nodes[n.next].prev = n.prev;
+    // Only a head can be left pointing at itself
+    if (n.prev < LEVELS * SLOTS && nodes[n.prev].next == n.prev) {
+        occupied[n.prev / SLOTS] &= ~((uint64_t)1 << (n.prev % SLOTS));
+    }
+    n.prev = n.next = NONE;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& n = nodes[index];
+    n.func = nullptr;
+    n.context = nullptr;
+    ++n.generation;  // ids handed out for this use stop matching
+    n.next = freeList;
+    freeList = index;
+    --count;
+}
+
+// Re-places the timers of the level's slot that tick has reached; they all
+// land in lower levels, except ones still beyond the top level's span
+void TimerWheel::cascade(int level, uint64_t tick) {
+    uint32_t head = level * SLOTS + (uint32_t)((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    uint32_t index = nodes[head].next;
+    if (index == head) return;
+    // Detach the whole list first, since place() may link into this slot again
+    nodes[nodes[head].prev].next = NONE;
+    nodes[head].prev = nodes[head].next = head;
+    occupied[level] &= ~((uint64_t)1 << (head % SLOTS));
+    while (index != NONE) {
+        uint32_t next = nodes[index].next;
+        place(index);
+        index = next;
+    }
+}
+
+// Runs the timers of the level 0 slot for tick
+void TimerWheel::expire(uint64_t tick) {
+    uint32_t head = (uint32_t)(tick & (SLOTS - 1));
+    // Callbacks may cancel or schedule timers, but nothing they schedule is
+    // due this tick, so the list only shrinks
+    while (nodes[head].next != head) {
+        uint32_t index = nodes[head].next;
+        unlink(index);
+        Node& n = nodes[index];
+        timerFunc func = n.func;
+        void* context = n.context;
+        if (n.intervalMs > 0) {
+            // Rearm before calling, so the callback may cancel it
+            n.expires = tick + n.intervalMs;
+            place(index);
+        } else {
+            release(index);
+        }
+        func(context);
+    }
+}
+
+// Earliest tick at which a non-empty slot is reached, on any level
+uint64_t TimerWheel::nextEventTick() const {
+    uint64_t best = UINT64_MAX;
+    for (int level = 0; level < LEVELS; ++level) {
+        uint64_t bits = occupied[level];
+        if (!bits) continue;
+        uint64_t base = current >> (SLOT_BITS * level);
+        // Rotate so bit 0 is the slot after the current one
+        unsigned start = (unsigned)((base + 1) & (SLOTS - 1));
+        uint64_t rotated = start ? (bits >> start) | (bits << (SLOTS - start)) : bits;
+        uint64_t tick = (base + 1 + __builtin_ctzll(rotated)) << (SLOT_BITS * level);
+        if (tick < best) best = tick;
+    }
+    return best;
+}
+
+// Moves time forward to nowMs, running every timer due by then. Only ticks
+// where a slot has work are visited, so a long quiet gap costs nothing.
+void TimerWheel::advance(uint64_t nowMs) {
+    while (count > 0) {
+        uint64_t tick = nextEventTick();
+        if (tick > nowMs) break;
+        current = tick;
+        for (int level = LEVELS - 1; level > 0; --level) {
+            if ((tick & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) == 0) cascade(level, tick);
+        }
+        expire(tick);
+    }
+    if (nowMs > current) current = nowMs;
+}
+
+// Milliseconds until the wheel next needs advancing, -1 if it is empty
+int TimerWheel::timeoutMs() const {
+    if (count == 0) return -1;
+    uint64_t wait = nextEventTick() - current;
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
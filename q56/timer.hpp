@@ -0,0 +1,74 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Timer callback, run on the thread that advances the wheel
+typedef void (*timerFunc)(void* context);
+
+// Handle of a scheduled timer; 0 is never a valid one
+typedef uint64_t TimerId;
+
+// Hierarchical timing wheel with millisecond ticks: four levels of 64 slots
+// cover about 4.6 hours, and anything further out is parked in the last slot
+// and cascaded again. Scheduling and cancelling are O(1); nodes are recycled
+// through a free list, so a timer that fires and rearms allocates nothing.
+// Single-threaded: one thread schedules, cancels and advances.
+class TimerWheel {
+public:
+    explicit TimerWheel(uint64_t nowMs);
+
+    // Runs func(context) delayMs after nowMs, then every intervalMs if that is
+    // non-zero. nowMs may be ahead of the last advance: a caller woken after a
+    // long wait schedules from the time it actually runs, and timers due in
+    // between still fire at the next advance.
+    TimerId schedule(uint64_t nowMs, uint64_t delayMs, uint64_t intervalMs, timerFunc func, void* context);
+
+    // Stops a timer; false if it already fired (one-shot) or was cancelled
+    bool cancel(TimerId id);
+
+    // Moves time forward to nowMs, running every timer due by then
+    void advance(uint64_t nowMs);
+
+    // Milliseconds until the wheel next needs advancing, -1 if it is empty.
+    // Waking then may only cascade timers from an upper level.
+    int timeoutMs() const;
+
+    // Timers scheduled and not yet fired or cancelled
+    size_t size() const { return count; }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const uint32_t NONE = 0xffffffff;
+
+    // List nodes; the first LEVELS * SLOTS are the slot list heads
+    struct Node {
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;   // bumped on reuse so stale ids miss
+        uint64_t expires;      // absolute tick
+        uint64_t intervalMs;   // 0 for one-shot
+        timerFunc func;        // nullptr while free
+        void* context;
+    };
+
+    void place(uint32_t index);
+    void link(uint32_t head, uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void cascade(int level, uint64_t tick);
+    void expire(uint64_t tick);
+    uint64_t nextEventTick() const;
+
+    std::vector<Node> nodes;
+    uint32_t freeList;
+    uint64_t current;   // last tick processed
+    size_t count;
+    uint64_t occupied[LEVELS];   // bit per non-empty slot, for nextEventTick
+};
+
+#endif // TIMER_HPP
@@ -0,0 +1,91 @@
+#include "workers.hpp"
+#include <sstream>
+
+WorkerPool workers;
+
+WorkerPool::WorkerPool() : maxQueued(0), stopping(false), completed(0), rejected(0) {}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+// Starts threads workers taking jobs from a queue of at most maxQueued
+void WorkerPool::start(int count, size_t limit) {
+    maxQueued = limit;
+    for (int i = 0; i < count; ++i) threads.emplace_back(&WorkerPool::run, this);
+}
+
+bool WorkerPool::enabled() const {
+    return !threads.empty();
+}
+
+// Queues func(job) for a worker; false if the queue is full
+bool WorkerPool::submit(workerFunc func, void* job) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping || queue.size() >= maxQueued) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue.push_back(Job{func, job});
+    }
+    available.notify_one();
+    return true;
+}
+
+// Stops the workers once the queue is empty
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& t : threads) t.join();
+    threads.clear();
+}
+
+void WorkerPool::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            available.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            job = queue.front();
+            queue.pop_front();
+        }
+        job.func(job.job);
+        completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Plain text lines for the Stats command
+std::string WorkerPool::report() const {
+    if (!enabled()) return "";
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queued = queue.size();
+    }
+    std::stringstream out;
+    out << "workers " << threads.size() << " queued " << queued << " queue_limit " << maxQueued << " completed "
+        << completed.load() << " rejected " << rejected.load() << "\n";
+    return out.str();
+}
+
+// Prometheus lines for the metrics listener
+std::string WorkerPool::prometheus() const {
+    if (!enabled()) return "";
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queued = queue.size();
+    }
+    std::stringstream out;
+    out << "scc_worker_threads " << threads.size() << "\n";
+    out << "scc_worker_queue_depth " << queued << "\n";
+    out << "scc_worker_queue_limit " << maxQueued << "\n";
+    out << "scc_worker_jobs_completed_total " << completed.load() << "\n";
+    out << "scc_worker_jobs_rejected_total " << rejected.load() << "\n";
+    return out.str();
+}
@@ -0,0 +1,63 @@
+#ifndef WORKERS_HPP
+#define WORKERS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Work run on a pool thread; job is whatever the submitter handed over
+typedef void (*workerFunc)(void* job);
+
+// Fixed set of threads that run commands off the event loops. The queue in
+// front of them is bounded: when it is full a job is refused, not queued, so
+// a burst of requests cannot grow memory or latency without limit.
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // Starts threads workers taking jobs from a queue of at most maxQueued
+    void start(int threads, size_t maxQueued);
+
+    // Whether start() created any workers
+    bool enabled() const;
+
+    // Queues func(job) for a worker; false, with job untouched, if the queue is full
+    bool submit(workerFunc func, void* job);
+
+    // Stops the workers once the queue is empty
+    void stop();
+
+    // Plain text lines for the Stats command
+    std::string report() const;
+
+    // Prometheus lines for the metrics listener
+    std::string prometheus() const;
+
+private:
+    struct Job {
+        workerFunc func;
+        void* job;
+    };
+
+    void run();
+
+    std::vector<std::thread> threads;
+    std::deque<Job> queue;          // under mtx
+    size_t maxQueued;
+    bool stopping;                  // under mtx
+    mutable std::mutex mtx;
+    std::condition_variable available;
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> rejected;
+};
+
+extern WorkerPool workers;
+
+#endif // WORKERS_HPP
@@ -1,7 +1,5 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include <stack>
 #include <algorithm>
 #include <thread>
 #include <sstream>
@@ -11,6 +9,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <mutex>
+#include "../common/scc_engine.hpp"
 
 using namespace std;
 
@@ -19,68 +18,6 @@ int n = 0, m = 0;                 // Number of vertices (n) and edges (m)
 vector<pair<int, int>> edges;     // store edges as pairs of integers (u, v)
 mutex graphMutex;                 // Mutex for safe access to graph data
 
-// Depth-first search (DFS) to populate finishStack for Kosaraju's algorithm
-void dfs1(int v, const vector<list<int>>& adj, vector<bool>& visited, stack<int>& finishStack) {
-    visited[v] = true;  // Mark the current vertex as visited
-    // Traverse all adjacent vertices recursively
-    for (int u : adj[v]) {
-        if (!visited[u]) {
-            dfs1(u, adj, visited, finishStack);  // Recursive call for unvisited adjacent vertex
-        }
-    }
-    finishStack.push(v);  // Push the vertex onto the stack once all its adjacent vertices are visited
-}
-
-// DFS for the reverse graph to build strongly connected components (SCCs)
-void dfs2(int v, const vector<list<int>>& revAdj, vector<bool>& visited, vector<int>& component) {
-    visited[v] = true;  // Mark the current vertex as visited
-    component.push_back(v);  // Add the vertex to the current component
-    // Traverse all adjacent vertices in the reverse graph recursively
-    for (int u : revAdj[v]) {
-        if (!visited[u]) {
-            dfs2(u, revAdj, visited, component);  // Recursive call for unvisited adjacent vertex
-        }
-    }
-}
-
-// Kosaraju's algorithm to find all SCCs in a directed graph
-vector<vector<int>> kosaraju(int n, const vector<pair<int, int>>& edges) {
-    vector<list<int>> adj(n + 1), revAdj(n + 1);  // Adjacency list and reverse adjacency list for the graph
-
-    // Constructing the adjacency list and reverse adjacency list from edges
-    for (const auto& edge : edges) {
-        adj[edge.first].push_back(edge.second);    // Original graph adjacency list
-        revAdj[edge.second].push_back(edge.first); // Reverse graph adjacency list
-    }
-
-    stack<int> finishStack;             // Stack to store vertices based on finish times
-    vector<bool> visited(n + 1, false); // Array to track visited vertices
-
-    // Step 1: Perform DFS on the original graph and populate finishStack
-    for (int i = 1; i <= n; ++i) {
-        if (!visited[i]) {
-            dfs1(i, adj, visited, finishStack);  // Perform DFS on unvisited vertices
-        }
-    }
-
-    fill(visited.begin(), visited.end(), false);  // Reset visited array for the second DFS
-    vector<vector<int>> sccs;  // Vector to store all strongly connected components (SCCs)
-
-    // Step 2: Process vertices in order of decreasing finish time (from finishStack)
-    while (!finishStack.empty()) {
-        int v = finishStack.top();  // Get the vertex with the highest finish time
-        finishStack.pop();          // Remove the vertex from the stack
-
-        if (!visited[v]) {
-            vector<int> component;  // Vector to store the current SCC
-            dfs2(v, revAdj, visited, component);  // Perform DFS on the reverse graph to find SCC
-            sccs.push_back(component);  // Add the SCC to the list of SCCs found
-        }
-    }
-
-    return sccs;  // Return all strongly connected components (SCCs) found
-}
-
 // Function to handle client commands and interact with the graph
 void handleClient(int clientSocket) {
     char buffer[1024] = {0};  // Buffer to store incoming data from client
@@ -132,7 +69,7 @@ void handleClient(int clientSocket) {
             vector<vector<int>> sccs;
             {
                 lock_guard<mutex> lock(graphMutex);
-                sccs = kosaraju(n, edges);  // Invoke Kosaraju's algorithm to find SCCs
+                sccs = scc::kosaraju(n, edges);  // Invoke Kosaraju's algorithm to find SCCs
             }
 
             // Prepare response containing all SCCs found
@@ -1,7 +1,5 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include <stack>
 #include <algorithm>
 #include <thread>
 #include <sstream>
@@ -10,6 +8,7 @@
 #include <arpa/inet.h>
 #include <mutex>
 #include "reactor.hpp"
+#include "../common/scc_engine.hpp"
 
 using namespace std;
 
@@ -17,71 +16,6 @@ mutex graphMutex;
 int n = 0, m = 0;
 vector<pair<int, int>> edges;
 
-void dfs1(int v, const vector<list<int>> &adj, vector<bool> &visited, stack<int> &finishStack)
-{
-    visited[v] = true;
-    for (int u : adj[v])
-    {
-        if (!visited[u])
-        {
-            dfs1(u, adj, visited, finishStack);
-        }
-    }
-    finishStack.push(v);
-}
-
-void dfs2(int v, const vector<list<int>> &revAdj, vector<bool> &visited, vector<int> &component)
-{
-    visited[v] = true;
-    component.push_back(v);
-    for (int u : revAdj[v])
-    {
-        if (!visited[u])
-        {
-            dfs2(u, revAdj, visited, component);
-        }
-    }
-}
-
-vector<vector<int>> kosaraju(int n, const vector<pair<int, int>> &edges)
-{
-    vector<list<int>> adj(n + 1), revAdj(n + 1);
-    for (const auto &edge : edges)
-    {
-        adj[edge.first].push_back(edge.second);
-        revAdj[edge.second].push_back(edge.first);
-    }
-
-    stack<int> finishStack;
-    vector<bool> visited(n + 1, false);
-
-    for (int i = 1; i <= n; ++i)
-    {
-        if (!visited[i])
-        {
-            dfs1(i, adj, visited, finishStack);
-        }
-    }
-
-    fill(visited.begin(), visited.end(), false);
-    vector<vector<int>> sccs;
-
-    while (!finishStack.empty())
-    {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v])
-        {
-            vector<int> component;
-            dfs2(v, revAdj, visited, component);
-            sccs.push_back(component);
-        }
-    }
-
-    return sccs;
-}
-
 void *handleClient(int fd)
 {
     char buffer[1024] = {0};
@@ -123,7 +57,7 @@ void *handleClient(int fd)
             vector<vector<int>> sccs;
             {
                 lock_guard<mutex> lock(graphMutex);
-                sccs = kosaraju(n, edges);
+                sccs = scc::kosaraju(n, edges);
             }
             stringstream response;
             response << "scc:\n";
@@ -1,12 +1,13 @@
 #include "reactor.hpp"
-#include <poll.h>
 #include <thread>
 #include <unistd.h>
 #include <algorithm>
 #include <iostream>
 
 // Constructor
-Reactor::Reactor() : running(false) {}
+Reactor::Reactor() : poller(createPoller(BACKEND_EPOLL)), hasPending(false), running(false) {
+    poller->add(wakeup.fd(), POLLER_READ);
+}
 
 // Start Reactor
 Reactor* Reactor::startReactor() {
@@ -17,53 +18,75 @@ Reactor* Reactor::startReactor() {
     return reactor;
 }
 
-// Add FD to Reactor
+// Add FD to Reactor; the loop thread registers it before its next wait
 int Reactor::addFdToReactor(int fd, reactorFunc func) {
+    if (fd < 0 || !func) return -1;
     std::lock_guard<std::mutex> lock(mtx);
-    fdMap[fd] = func;
-    pollfds.push_back({fd, POLLIN, 0});
+    pending.push_back(Change{fd, func});
+    if (!hasPending.exchange(true)) wakeup.signal();
     return 0;
 }
 
 // Remove FD from Reactor
 int Reactor::removeFdFromReactor(int fd) {
+    if (fd < 0) return -1;
     std::lock_guard<std::mutex> lock(mtx);
-    fdMap.erase(fd);
-    pollfds.erase(std::remove_if(pollfds.begin(), pollfds.end(),
-                                 [fd](const struct pollfd& pfd) { return pfd.fd == fd; }),
-                  pollfds.end());
+    pending.push_back(Change{fd, nullptr});
+    if (!hasPending.exchange(true)) wakeup.signal();
     return 0;
 }
 
+// Apply queued registrations on the loop thread, which alone owns the table
+void Reactor::applyChanges() {
+    std::vector<Change> changes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        changes.swap(pending);
+        hasPending = false;
+    }
+    for (Change& c : changes) {
+        if ((size_t)c.fd >= handlers.size()) handlers.resize(c.fd + 1);
+        if (c.func) {
+            // Registering again replaces the callback
+            if (!handlers[c.fd] && poller->add(c.fd, POLLER_READ) < 0) {
+                perror("epoll_ctl");
+                continue;
+            }
+            handlers[c.fd] = std::move(c.func);
+        } else if (handlers[c.fd]) {
+            handlers[c.fd] = nullptr;
+            poller->remove(c.fd);
+        }
+    }
+}
+
 // Stop Reactor
 int Reactor::stopReactor() {
     running = false;
+    wakeup.signal();
     return 0;
 }
 
 // Reactor Loop
 void Reactor::reactorLoop() {
     while (running) {
-        std::vector<struct pollfd> pollfdsCopy;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            pollfdsCopy = pollfds;
-        }
-        int ret = poll(pollfdsCopy.data(), pollfdsCopy.size(), 1000);
+        if (hasPending) applyChanges();
+        ready.clear();
+        int ret = poller->wait(ready, -1);
         if (ret < 0) {
-            perror("poll");
+            perror("epoll_wait");
             break;
         }
-        if (ret == 0) continue;
-        for (const auto& pfd : pollfdsCopy) {
-            if (pfd.revents & POLLIN) {
-                reactorFunc func;
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    func = fdMap[pfd.fd];
-                }
-                if (func) func(pfd.fd);
+        for (const auto& ev : ready) {
+            if (ev.fd == wakeup.fd()) {
+                wakeup.drain();
+                continue;
             }
+            // An fd removed since the wait must not fire
+            if (hasPending) applyChanges();
+            // One index into the table, no lock or copy; changes the
+            // callback makes are queued, so the slot stays put while it runs
+            if ((size_t)ev.fd < handlers.size() && handlers[ev.fd]) handlers[ev.fd](ev.fd);
         }
     }
 }
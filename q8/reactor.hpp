@@ -2,12 +2,11 @@
 #define REACTOR_HPP
 
 #include <functional>
-#include <map>
 #include <vector>
 #include <mutex>
 #include <atomic>
-#include <poll.h>
 #include <pthread.h>
+#include "../common/poller.hpp"
 
 typedef std::function<void(int)> reactorFunc;
 typedef void* (*proactorFunc)(int sockfd);
@@ -24,8 +23,17 @@ public:
 
 private:
     Reactor();
-    std::map<int, reactorFunc> fdMap;
-    std::vector<struct pollfd> pollfds;
+    Poller* poller;
+    struct Change {
+        int fd;
+        reactorFunc func;  // empty to remove
+    };
+    void applyChanges();
+    std::vector<reactorFunc> handlers;  // indexed by fd, loop thread only
+    std::vector<Change> pending;        // guarded by mtx
+    std::atomic<bool> hasPending;
+    std::vector<PollerEvent> ready;
+    Wakeup wakeup;
     std::mutex mtx;
     std::atomic<bool> running;
 };
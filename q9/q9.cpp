@@ -1,7 +1,5 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include <stack>
 #include <algorithm>
 #include <thread>
 #include <sstream>
@@ -10,6 +8,7 @@
 #include <arpa/inet.h>
 #include <mutex>
 #include "reactor.hpp"
+#include "../common/scc_engine.hpp"
 
 using namespace std;
 
@@ -18,78 +17,6 @@ int n = 0, m = 0;               // Number of vertices and edges
 vector<pair<int, int>> edges;   // Edges of the graph
 mutex graphMutex;               // Mutex for ensuring thread safety
 
-// Depth-first search function to fill finishing order in finishStack
-void dfs1(int v, const vector<list<int>> &adj, vector<bool> &visited, stack<int> &finishStack)
-{
-    visited[v] = true;
-    for (int u : adj[v])
-    {
-        if (!visited[u])
-        {
-            dfs1(u, adj, visited, finishStack); // Recursive call for unvisited neighbors
-        }
-    }
-    finishStack.push(v); // Push vertex to stack after all neighbors are visited
-}
-
-// Depth-first search function to find strongly connected components (SCCs)
-void dfs2(int v, const vector<list<int>> &revAdj, vector<bool> &visited, vector<int> &component)
-{
-    visited[v] = true;
-    component.push_back(v); // Add vertex to current SCC
-    for (int u : revAdj[v])
-    {
-        if (!visited[u])
-        {
-            dfs2(u, revAdj, visited, component); // Recursive call for unvisited neighbors
-        }
-    }
-}
-
-// Kosaraju's algorithm to find all SCCs in the graph
-vector<vector<int>> kosaraju(int n, const vector<pair<int, int>> &edges)
-{
-    vector<list<int>> adj(n + 1), revAdj(n + 1); // Adjacency list and reverse adjacency list
-
-    // Construct adjacency list and reverse adjacency list from edges
-    for (const auto &edge : edges)
-    {
-        adj[edge.first].push_back(edge.second);   // Original graph
-        revAdj[edge.second].push_back(edge.first); // Transposed graph
-    }
-
-    stack<int> finishStack;         // Stack to store finishing order of vertices
-    vector<bool> visited(n + 1, false); // Visited array to track visited vertices
-
-    // Perform first DFS to fill finishStack with vertices in finishing order
-    for (int i = 1; i <= n; ++i)
-    {
-        if (!visited[i])
-        {
-            dfs1(i, adj, visited, finishStack);
-        }
-    }
-
-    fill(visited.begin(), visited.end(), false); // Reset visited array
-    vector<vector<int>> sccs; // Vector of vectors to store SCCs
-
-    // Process vertices in order of decreasing finish times (top of finishStack)
-    while (!finishStack.empty())
-    {
-        int v = finishStack.top();
-        finishStack.pop();
-
-        if (!visited[v])
-        {
-            vector<int> component; // Vector to store current SCC
-            dfs2(v, revAdj, visited, component); // Perform DFS on transposed graph
-            sccs.push_back(component); // Add current SCC to list of SCCs
-        }
-    }
-
-    return sccs; // Return all SCCs found in the graph
-}
-
 // Function to handle client connections and process commands
 void *handleClient(int clientSocket)
 {
@@ -144,7 +71,7 @@ void *handleClient(int clientSocket)
             // Compute SCCs using Kosaraju's algorithm
             {
                 lock_guard<mutex> lock(graphMutex); // Lock mutex for thread safety
-                sccs = kosaraju(n, edges); // Compute SCCs for current graph state
+                sccs = scc::kosaraju(n, edges); // Compute SCCs for current graph state
             }
 
             // Prepare and send response with SCCs to client
@@ -1,12 +1,13 @@
 #include "reactor.hpp"
-#include <poll.h>
 #include <thread>
 #include <unistd.h>
 #include <algorithm>
 #include <iostream>
 
 // Constructor
-Reactor::Reactor() : running(false) {}
+Reactor::Reactor() : poller(createPoller(BACKEND_EPOLL)), hasPending(false), running(false) {
+    poller->add(wakeup.fd(), POLLER_READ);      // Watch the wakeup eventfd alongside the sockets
+}
 
 // Start Reactor
 Reactor* Reactor::startReactor() {
@@ -19,50 +20,71 @@ Reactor* Reactor::startReactor() {
 
 // Add FD to Reactor
 int Reactor::addFdToReactor(int fd, reactorFunc func) {
-    std::lock_guard<std::mutex> lock(mtx);       // Lock mutex to protect shared data
-    fdMap[fd] = func;                            // Add function callback for given file descriptor
-    pollfds.push_back({fd, POLLIN, 0});          // Add file descriptor to the pollfds list for polling
+    if (fd < 0 || !func) return -1;              // Reject what the loop could not register
+    std::lock_guard<std::mutex> lock(mtx);       // Lock mutex to protect the pending queue
+    pending.push_back(Change{fd, func});         // The loop thread registers it before its next wait
+    if (!hasPending.exchange(true)) wakeup.signal();  // One wakeup covers every queued change
     return 0;                                    
 }
 
 // Remove FD from Reactor
 int Reactor::removeFdFromReactor(int fd) {
-    std::lock_guard<std::mutex> lock(mtx);       // Lock mutex to protect shared data
-    fdMap.erase(fd);                             // Remove function callback for given file descriptor
-    pollfds.erase(std::remove_if(pollfds.begin(), pollfds.end(),
-                                 [fd](const struct pollfd& pfd) { return pfd.fd == fd; }),
-                  pollfds.end());                // Remove file descriptor from pollfds list
+    if (fd < 0) return -1;                       // Nothing to remove
+    std::lock_guard<std::mutex> lock(mtx);       // Lock mutex to protect the pending queue
+    pending.push_back(Change{fd, nullptr});      // An empty callback means remove
+    if (!hasPending.exchange(true)) wakeup.signal();  // Wake the loop so the fd stops firing
     return 0;                                    
 }
 
+// Apply queued registrations; runs on the loop thread only
+void Reactor::applyChanges() {
+    std::vector<Change> changes;                 // Taken out so the lock is held only for a swap
+    {
+        std::lock_guard<std::mutex> lock(mtx);   // Lock mutex to protect the pending queue
+        changes.swap(pending);                   // Take every queued change at once
+        hasPending = false;                      // Later changes signal the wakeup again
+    }
+    for (Change& c : changes) {                  // Apply in the order they were made
+        if ((size_t)c.fd >= handlers.size()) handlers.resize(c.fd + 1);  // Grow the table to cover the fd
+        if (c.func) {
+            bool known = (bool)handlers[c.fd];   // Registering again replaces the callback
+            if (!known && poller->add(c.fd, POLLER_READ) < 0) {
+                perror("epoll_ctl");             // Print error if registration fails
+                continue;
+            }
+            handlers[c.fd] = std::move(c.func);  // Store function callback for given file descriptor
+        } else if (handlers[c.fd]) {
+            handlers[c.fd] = nullptr;            // Free the slot for given file descriptor
+            poller->remove(c.fd);                // Remove file descriptor from the epoll set
+        }
+    }
+}
+
 // Stop Reactor
 int Reactor::stopReactor() {
     running = false;                             // Set running flag to false to stop reactor loop
+    wakeup.signal();                             // Interrupt the wait so the loop sees the flag now
     return 0;                                   
 }
 
 // Reactor Loop
 void Reactor::reactorLoop() {
     while (running) {                            // Loop while reactor is running
-        std::vector<struct pollfd> pollfdsCopy;   // Create a copy of pollfds for thread safety
-        {
-            std::lock_guard<std::mutex> lock(mtx);  // Lock mutex to protect shared data
-            pollfdsCopy = pollfds;                // Copy pollfds to local variable
-        }
-        int ret = poll(pollfdsCopy.data(), pollfdsCopy.size(), 1000);  // Poll for events with a timeout of 1000 ms
+        if (hasPending) applyChanges();          // The lock is only taken when something was queued
+        ready.clear();                           // Only descriptors that fired are returned, no copy of the set
+        int ret = poller->wait(ready, -1);       // Block until an fd fires or stopReactor wakes us
         if (ret < 0) {
-            perror("poll");                      // Print error if poll fails
-            break;                               // Exit loop on poll error
+            perror("epoll_wait");                // Print error if wait fails
+            break;                               // Exit loop on wait error
         }
-        if (ret == 0) continue;                  // Continue loop if no events occurred
-        for (const auto& pfd : pollfdsCopy) {     // Iterate through polled file descriptors
-            if (pfd.revents & POLLIN) {           // Check if input event occurred
-                reactorFunc func;                 // Declare function callback variable
-                {
-                    std::lock_guard<std::mutex> lock(mtx);  // Lock mutex to protect shared data
-                    func = fdMap[pfd.fd];          // Retrieve function callback for file descriptor
-                }
-                if (func) func(pfd.fd);           // Call function callback if not null
+        for (const auto& ev : ready) {           // Iterate through ready file descriptors
+            if (ev.fd == wakeup.fd()) {          // Wakeup eventfd: reset it, running is checked next
+                wakeup.drain();
+                continue;
+            }
+            if (hasPending) applyChanges();      // An fd removed since the wait must not fire
+            if ((size_t)ev.fd < handlers.size() && handlers[ev.fd]) {  // One index, no lock or copy
+                handlers[ev.fd](ev.fd);          // Call function callback; changes it makes are queued
             }
         }
     }
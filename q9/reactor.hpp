@@ -2,12 +2,11 @@
 #define REACTOR_HPP
 
 #include <functional>
-#include <map>
 #include <vector>
 #include <mutex>
 #include <atomic>
-#include <poll.h>
 #include <pthread.h>
+#include "../common/poller.hpp"
 
 typedef std::function<void(int)> reactorFunc;        // Define a type for reactor callback functions
 typedef void* (*proactorFunc)(int sockfd);           // Define a type for proactor callback functions
@@ -24,9 +23,15 @@ public:
 
 private:
     Reactor();                                       // Private constructor
-    std::map<int, reactorFunc> fdMap;                // Map to store file descriptors and their callbacks
-    std::vector<struct pollfd> pollfds;              // Vector of poll file descriptors
-    std::mutex mtx;                                  // Mutex to protect shared data
+    Poller* poller;                                  // epoll interest list, O(ready) per wakeup
+    struct Change { int fd; reactorFunc func; };     // Registration queued for the loop; no func means remove
+    void applyChanges();                             // Applies queued registrations on the loop thread
+    std::vector<reactorFunc> handlers;               // Callbacks indexed by fd, touched only by the loop thread
+    std::vector<Change> pending;                     // Registrations not yet applied, guarded by mtx
+    std::atomic<bool> hasPending;                    // Set while pending is non-empty; checked without the lock
+    std::vector<PollerEvent> ready;                  // Descriptors reported ready by the last wait
+    Wakeup wakeup;                                   // eventfd that interrupts the wait on stop
+    std::mutex mtx;                                  // Mutex guarding only the pending queue
     std::atomic<bool> running;                       // Atomic flag to indicate if reactor is running
 };
 